@@ -29,25 +29,17 @@ SOURCES += \
         mainwindow.cpp \
     leveleditor.cpp \
     levelitem.cpp \
-    levelformat.cpp \
-    abstractsolver.cpp \
-    dfssolver.cpp \
-    bfssolver.cpp \
-    lcfssolver.cpp \
-    astarsolver.cpp \
-    algorithmdialog.cpp
+    algorithmdialog.cpp \
+    solverthread.cpp
 
 HEADERS += \
         mainwindow.h \
     leveleditor.h \
     levelitem.h \
-    levelformat.h \
-    abstractsolver.h \
-    dfssolver.h \
-    bfssolver.h \
-    lcfssolver.h \
-    astarsolver.h \
-    algorithmdialog.h
+    algorithmdialog.h \
+    solverthread.h
+
+include(core.pri)
 
 FORMS +=
 
@@ -6,15 +6,90 @@
 AbstractSolver::AbstractSolver(LevelFormat *format) :
     level(format),
     solved(false),
-    solutionIndex(0)
+    solutionIndex(0),
+    cancelled(0),
+    published(false),
+    timeLimit(0),
+    memoryLimit(0),
+    peakMemory(0),
+    result(NotRun),
+    lastReportTime(0),
+    nodesExpanded(0),
+    corralPrunedPushes(0),
+    phases(),
+    workerTotals(),
+    elapsedTime(0)
 {
 
 }
 
 AbstractSolver::~AbstractSolver()
 {
-    for (LevelState *state : solution)
-        delete state;
+
+}
+
+/*
+ * Runs the search to completion, or until cancelled or a limit is reached,
+ * returning whether a solution was found. outcome() tells which.
+ */
+bool AbstractSolver::run()
+{
+    cancelled.storeRelease(0);
+    searchTimer.start();
+    lastReportTime = 0;
+    nodesExpanded = 0;
+    corralPrunedPushes = 0;
+    workerTotals = SolveStatistics();
+    result = NotRun;
+    published = false;
+    peakMemory = 0;
+    level->setMacroMoves(!findsOptimalSolutions());
+    level->setCorralPruning(!findsOptimalSolutions());
+    PhaseTotals phasesBefore = PhaseTimer::threadTotals();
+    bool found = solve();
+    memoryProbe = nullptr;
+    peakMemory = qMax(peakMemory, nodes.bytesAllocated() + workerTotals.memoryBytes);
+    phases = PhaseTimer::threadTotals() - phasesBefore;
+    solved = published || (found && !isCancelled() && result == NotRun);
+    elapsedTime = searchTimer.elapsed();
+    if (solved)
+        result = Solved;
+    else if (isCancelled())
+        result = Cancelled;
+    else if (result == NotRun)
+        result = NoSolution;
+    reportProgress(0, -1);
+    return solved;
+}
+
+void AbstractSolver::cancel()
+{
+    cancelled.storeRelease(1);
+}
+
+bool AbstractSolver::isCancelled() const
+{
+    return cancelled.loadAcquire() != 0;
+}
+
+void AbstractSolver::setProgressCallback(const ProgressCallback &callback)
+{
+    progressCallback = callback;
+}
+
+void AbstractSolver::setSolutionCallback(const SolutionCallback &callback)
+{
+    solutionCallback = callback;
+}
+
+void AbstractSolver::setTimeLimit(qint64 milliseconds)
+{
+    timeLimit = milliseconds;
+}
+
+void AbstractSolver::setMemoryLimit(qint64 bytes)
+{
+    memoryLimit = bytes;
 }
 
 bool AbstractSolver::isSolved() const
@@ -22,6 +97,37 @@ bool AbstractSolver::isSolved() const
     return solved;
 }
 
+AbstractSolver::Outcome AbstractSolver::outcome() const
+{
+    return result;
+}
+
+SolveStatistics AbstractSolver::statistics() const
+{
+    SolveStatistics result;
+    result.nodesExpanded = nodesExpanded;
+    result.nodesGenerated = nodes.size() + workerTotals.nodesGenerated;
+    result.elapsedMilliseconds = elapsedTime;
+    result.memoryBytes = peakMemory;
+    result.corralPrunedPushes = corralPrunedPushes + workerTotals.corralPrunedPushes;
+    result.phases = phases;
+    result.phases += workerTotals.phases;
+    return result;
+}
+
+const QList<LevelState *> &AbstractSolver::getSolution() const
+{
+    return solution;
+}
+
+QString AbstractSolver::getSolutionMoves() const
+{
+    QString moves;
+    for (int i = 1; i < solution.size(); ++i)
+        moves += level->movesBetween(solution.at(i - 1), solution.at(i));
+    return moves;
+}
+
 LevelState *AbstractSolver::stepForward()
 {
     if (solved) {
@@ -66,3 +172,101 @@ bool AbstractSolver::solve()
 {
     return false;
 }
+
+bool AbstractSolver::findsOptimalSolutions() const
+{
+    return false;
+}
+
+void AbstractSolver::buildSolution(quint32 goalIndex)
+{
+    solution.clear();
+    for (quint32 index = goalIndex; index != NodeArena::NoNode; index = nodes.at(index)->previousState)
+        solution.prepend(nodes.at(index));
+}
+
+void AbstractSolver::publishSolution(quint32 goalIndex, int lowerBound)
+{
+    buildSolution(goalIndex);
+    published = true;
+    if (!solutionCallback)
+        return;
+    SolutionReport report;
+    report.cost = nodes.at(goalIndex)->cost;
+    report.lowerBound = lowerBound;
+    report.elapsedMilliseconds = searchTimer.elapsed();
+    solutionCallback(report);
+}
+
+void AbstractSolver::setMemoryProbe(const std::function<qint64()> &probe)
+{
+    memoryProbe = probe;
+}
+
+void AbstractSolver::generateNextStates(LevelState *state, QVector<LevelState> &nextStates)
+{
+    corralPrunedPushes += level->nextStatesFor(state, nextStates);
+}
+
+/*
+ * Counts an expansion and reports progress at most every 100ms. Checking
+ * the cancel flag on every expansion keeps cancellation within a few
+ * milliseconds without needing any locking. The limits are only checked
+ * every 256 expansions to keep the timer out of the inner loop.
+ */
+bool AbstractSolver::keepSearching(int frontierSize, int bestFValue)
+{
+    ++nodesExpanded;
+    if ((nodesExpanded & 255) == 0) {
+        qint64 elapsed = searchTimer.elapsed();
+        if (!withinLimits(elapsed))
+            return false;
+        if (progressCallback && elapsed - lastReportTime >= 100)
+            reportProgress(frontierSize, bestFValue);
+    }
+    return !isCancelled();
+}
+
+void AbstractSolver::recordWorkerTotals(const SolveStatistics &totals)
+{
+    nodesExpanded = totals.nodesExpanded;
+    workerTotals = totals;
+}
+
+/*
+ * Meant to be polled every few milliseconds, so unlike keepSearching() it
+ * checks the limits and the progress timer on every call.
+ */
+bool AbstractSolver::keepSearchingInParallel(int frontierSize, int bestFValue)
+{
+    qint64 elapsed = searchTimer.elapsed();
+    if (!withinLimits(elapsed))
+        return false;
+    if (progressCallback && elapsed - lastReportTime >= 100)
+        reportProgress(frontierSize, bestFValue);
+    return !isCancelled();
+}
+
+bool AbstractSolver::withinLimits(qint64 elapsed)
+{
+    qint64 memory = nodes.bytesAllocated() + workerTotals.memoryBytes + (memoryProbe ? memoryProbe() : 0);
+    peakMemory = qMax(peakMemory, memory);
+    if (timeLimit > 0 && elapsed >= timeLimit)
+        result = TimedOut;
+    else if (memoryLimit > 0 && memory >= memoryLimit)
+        result = OutOfMemory;
+    return result == NotRun;
+}
+
+void AbstractSolver::reportProgress(int frontierSize, int bestFValue)
+{
+    if (!progressCallback)
+        return;
+    lastReportTime = searchTimer.elapsed();
+    SolveProgress progress;
+    progress.nodesExpanded = nodesExpanded;
+    progress.frontierSize = frontierSize;
+    progress.nodesPerSecond = lastReportTime > 0 ? nodesExpanded * 1000.0 / lastReportTime : 0;
+    progress.bestFValue = bestFValue;
+    progressCallback(progress);
+}
@@ -1,35 +1,147 @@
 #ifndef ABSTRACTSOLVER_H
 #define ABSTRACTSOLVER_H
 
+#include "nodearena.h"
+#include "phasecounters.h"
+
+#include <functional>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QList>
+#include <QString>
+#include <QVector>
 
 class LevelFormat;
 struct LevelState;
 
+struct SolveProgress
+{
+    qint64 nodesExpanded;
+    int frontierSize;
+    double nodesPerSecond;
+    int bestFValue; // -1 for solvers that do not order by f-value
+};
+
+struct SolutionReport
+{
+    int cost; // moves in the solution
+    int lowerBound; // no solution has fewer moves, equal to cost once it is proved optimal
+    qint64 elapsedMilliseconds;
+};
+
+struct SolveStatistics
+{
+    qint64 nodesExpanded;
+    qint64 nodesGenerated; // states stored in the node arena
+    qint64 elapsedMilliseconds;
+    qint64 memoryBytes; // the most held at once by nodes, tables and open lists, sampled with the limits
+    qint64 corralPrunedPushes; // pushes skipped because a PI-corral had to be dealt with first
+    PhaseTotals phases; // all zero unless PhaseTimer is enabled
+};
+
 /*
  * Solver classes are responsible for finding a solution and supplying
- * pointers to states when requested for rendering. They are also responsible
- * for deleting the states they request from the level format, but not the
- * format itself (that is done by the level editor).
+ * pointers to states when requested for rendering. Every state they store
+ * lives in their node arena, which is freed in one go when the solver is
+ * destroyed. They do not own the level format (that is done by the level
+ * editor).
+ *
+ * Constructing a solver does not start the search; run() does, and may be
+ * called from a worker thread. While it runs, cancel() is the only member
+ * that may be called from another thread, and the progress callback is
+ * invoked from the thread doing the search, as is the solution callback of
+ * anytime solvers, which publish every better solution they find and keep
+ * searching. If such a solver is stopped early, it still counts as solved
+ * with the last solution it published. Solvers share no state with
+ * each other, so several can run at once as long as each has its own
+ * level format.
  */
 
 class AbstractSolver
 {
 public:
+    typedef std::function<void(const SolveProgress &)> ProgressCallback;
+    typedef std::function<void(const SolutionReport &)> SolutionCallback;
+
+    enum Outcome {
+        NotRun,
+        Solved,
+        NoSolution,
+        Cancelled,
+        TimedOut, // the time limit was reached
+        OutOfMemory // the search outgrew the memory limit
+    };
+
     AbstractSolver(LevelFormat *format);
     virtual ~AbstractSolver();
+    bool run();
+    void cancel();
+    bool isCancelled() const;
+    void setProgressCallback(const ProgressCallback &callback);
+    void setSolutionCallback(const SolutionCallback &callback);
+    // a limit of 0 means unlimited, both are checked every 256 expansions;
+    // the memory limit covers the node arena and what the probe reports
+    void setTimeLimit(qint64 milliseconds);
+    void setMemoryLimit(qint64 bytes);
     bool isSolved() const;
+    Outcome outcome() const;
+    SolveStatistics statistics() const;
+    const QList<LevelState *> &getSolution() const;
+    QString getSolutionMoves() const; // LURD notation, empty if unsolved
     LevelState *stepForward();
     LevelState *fastForward();
     LevelState *stepBackward();
     LevelState *fastBackward();
 protected:
     virtual bool solve();
+    // solvers that find the fewest moves have run() turn off the shortcuts
+    // of LevelFormat that can make solutions longer
+    virtual bool findsOptimalSolutions() const;
+    void buildSolution(quint32 goalIndex); // follows parent links back to the start
+    // for anytime solvers: builds the solution and reports it
+    void publishSolution(quint32 goalIndex, int lowerBound);
+    // solve() registers one for the tables, open lists and buffers it keeps
+    // besides the node arena, so that they count toward the memory limit;
+    // it is dropped once solve() returns
+    void setMemoryProbe(const std::function<qint64()> &probe);
+    // LevelFormat::nextStatesFor, counting what corral pruning cut
+    void generateNextStates(LevelState *state, QVector<LevelState> &nextStates);
+    // call once per expanded node, returns false if the search should stop
+    bool keepSearching(int frontierSize, int bestFValue = -1);
+    // for solvers that expand nodes on worker threads and keep them in
+    // their own arenas: the thread running solve() records the workers'
+    // totals (all but the elapsed time, and their phases once they are
+    // done, with memoryBytes being what they hold now) and polls
+    // keepSearchingInParallel()
+    // instead of keepSearching()
+    void recordWorkerTotals(const SolveStatistics &totals);
+    bool keepSearchingInParallel(int frontierSize, int bestFValue = -1);
 
     LevelFormat *level;
+    NodeArena nodes;
     QList<LevelState *> solution;
     bool solved;
     int solutionIndex;
+private:
+    bool withinLimits(qint64 elapsed);
+    void reportProgress(int frontierSize, int bestFValue);
+
+    QAtomicInt cancelled;
+    ProgressCallback progressCallback;
+    SolutionCallback solutionCallback;
+    std::function<qint64()> memoryProbe;
+    bool published;
+    qint64 timeLimit;
+    qint64 memoryLimit;
+    qint64 peakMemory;
+    Outcome result;
+    QElapsedTimer searchTimer;
+    qint64 lastReportTime;
+    qint64 nodesExpanded;
+    qint64 corralPrunedPushes;
+    PhaseTotals phases; // of the thread running solve()
+    SolveStatistics workerTotals;
+    qint64 elapsedTime;
 };
 
 #endif // ABSTRACTSOLVER_H
@@ -1,6 +1,8 @@
 #include "algorithmdialog.h"
 #include "mainwindow.h"
+#include "phasecounters.h"
 
+#include <QCheckBox>
 #include <QGroupBox>
 #include <QPushButton>
 #include <QRadioButton>
@@ -13,10 +15,20 @@ AlgorithmDialog::AlgorithmDialog(MainWindow::Algorithm currentAlgorithm)
     QGroupBox *groupBox = new QGroupBox;
     QVBoxLayout *algorithmsLayout = new QVBoxLayout;
     aStarButton = new QRadioButton(tr("A* (recommended)"));
+    anytimeAStarButton = new QRadioButton(tr("Anytime A* (quick first solution, then better ones)"));
+    parallelAStarButton = new QRadioButton(tr("Parallel A* (uses every core)"));
+    idaStarButton = new QRadioButton(tr("IDA* (uses little memory)"));
+    externalAStarButton = new QRadioButton(tr("External A* (uses the disk when memory runs out)"));
+    bidirectionalButton = new QRadioButton(tr("Bidirectional (fast, few pushes)"));
     lcfsButton = new QRadioButton(tr("LCFS (not as recommended)"));
     dfsButton = new QRadioButton(tr("DFS (not recommended)"));
     bfsButton = new QRadioButton(tr("BFS (REALLY not recommended)"));
     algorithmsLayout->addWidget(aStarButton);
+    algorithmsLayout->addWidget(anytimeAStarButton);
+    algorithmsLayout->addWidget(parallelAStarButton);
+    algorithmsLayout->addWidget(idaStarButton);
+    algorithmsLayout->addWidget(externalAStarButton);
+    algorithmsLayout->addWidget(bidirectionalButton);
     algorithmsLayout->addWidget(lcfsButton);
     algorithmsLayout->addWidget(dfsButton);
     algorithmsLayout->addWidget(bfsButton);
@@ -24,6 +36,21 @@ AlgorithmDialog::AlgorithmDialog(MainWindow::Algorithm currentAlgorithm)
     case MainWindow::AStar:
         aStarButton->setChecked(true);
         break;
+    case MainWindow::AnytimeAStar:
+        anytimeAStarButton->setChecked(true);
+        break;
+    case MainWindow::ParallelAStar:
+        parallelAStarButton->setChecked(true);
+        break;
+    case MainWindow::IDAStar:
+        idaStarButton->setChecked(true);
+        break;
+    case MainWindow::ExternalAStar:
+        externalAStarButton->setChecked(true);
+        break;
+    case MainWindow::Bidirectional:
+        bidirectionalButton->setChecked(true);
+        break;
     case MainWindow::LCFS:
         lcfsButton->setChecked(true);
         break;
@@ -36,6 +63,12 @@ AlgorithmDialog::AlgorithmDialog(MainWindow::Algorithm currentAlgorithm)
     }
     groupBox->setLayout(algorithmsLayout);
 
+    phaseCountersBox = new QCheckBox(tr("Time each phase of the search (slightly slower)"));
+    phaseCountersBox->setChecked(PhaseTimer::isEnabled());
+#ifdef NO_PHASE_COUNTERS
+    phaseCountersBox->setEnabled(false);
+#endif
+
     QHBoxLayout *choicesLayout = new QHBoxLayout;
     QPushButton *okButton = new QPushButton(tr("OK"));
     connect(okButton, SIGNAL(released()),
@@ -47,13 +80,24 @@ AlgorithmDialog::AlgorithmDialog(MainWindow::Algorithm currentAlgorithm)
     choicesLayout->addWidget(cancelButton);
 
     centralLayout->addWidget(groupBox);
+    centralLayout->addWidget(phaseCountersBox);
     centralLayout->addLayout(choicesLayout);
     setLayout(centralLayout);
 }
 
 MainWindow::Algorithm AlgorithmDialog::getAlgorithm()
 {
-    if (lcfsButton->isChecked())
+    if (anytimeAStarButton->isChecked())
+        return MainWindow::AnytimeAStar;
+    else if (parallelAStarButton->isChecked())
+        return MainWindow::ParallelAStar;
+    else if (idaStarButton->isChecked())
+        return MainWindow::IDAStar;
+    else if (externalAStarButton->isChecked())
+        return MainWindow::ExternalAStar;
+    else if (bidirectionalButton->isChecked())
+        return MainWindow::Bidirectional;
+    else if (lcfsButton->isChecked())
         return MainWindow::LCFS;
     else if (dfsButton->isChecked())
         return MainWindow::DFS;
@@ -61,3 +105,8 @@ MainWindow::Algorithm AlgorithmDialog::getAlgorithm()
         return MainWindow::BFS;
     return MainWindow::AStar; // the recommended default
 }
+
+bool AlgorithmDialog::countsPhases()
+{
+    return phaseCountersBox->isChecked();
+}
@@ -5,6 +5,7 @@
 
 #include <QDialog>
 
+class QCheckBox;
 class QRadioButton;
 
 class AlgorithmDialog : public QDialog
@@ -12,11 +13,18 @@ class AlgorithmDialog : public QDialog
 public:
     AlgorithmDialog(MainWindow::Algorithm currentAlgorithm);
     MainWindow::Algorithm getAlgorithm();
+    bool countsPhases(); // whether to time the phases of the search
 private:
     QRadioButton *aStarButton;
+    QRadioButton *parallelAStarButton;
+    QRadioButton *idaStarButton;
+    QRadioButton *externalAStarButton;
+    QRadioButton *bidirectionalButton;
+    QRadioButton *anytimeAStarButton;
     QRadioButton *lcfsButton;
     QRadioButton *dfsButton;
     QRadioButton *bfsButton;
+    QCheckBox *phaseCountersBox;
 };
 
 #endif // ALGORITHMDIALOG_H
@@ -0,0 +1,117 @@
+#include "anytimeastarsolver.h"
+#include "levelformat.h"
+#include "transpositiontable.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// in hundredths, the first weight makes the search nearly greedy
+const int Weights[] = { 500, 300, 200, 150, 125, 110, 100 };
+
+}
+
+AnytimeAStarSolver::AnytimeAStarSolver(LevelFormat *format):
+    AbstractSolver (format),
+    weight(Weights[0])
+{
+
+}
+
+bool AnytimeAStarSolver::solve()
+{
+    frontier.clear();
+    TranspositionTable table(level);
+    setMemoryProbe([&] { return table.bytesUsed() + qint64(frontier.capacity()) * qint64(sizeof(Entry)); });
+    QVector<LevelState> nextStates;
+    int initialHeuristic = level->getHeuristic(level->getInitialState());
+    if (initialHeuristic == -1)
+        return false;
+    int weightIndex = 0;
+    weight = Weights[0];
+    push({ initialHeuristic * weight, initialHeuristic, initialHeuristic,
+           nodes.allocate(*level->getInitialState(), NodeArena::NoNode) });
+    quint32 best = NodeArena::NoNode;
+    int bestCost = INT_MAX;
+    while (!frontier.empty()) {
+        // nothing left can beat the best solution by more than the weight
+        // allows, so it is good enough for this weight
+        if (best != NodeArena::NoNode && frontier.front().priority >= bestCost * 100) {
+            if (weight == 100)
+                break;
+            reorder(Weights[++weightIndex]);
+            continue;
+        }
+        Entry entry = pop();
+        if (entry.fValue >= bestCost)
+            continue; // the heuristic never overestimates, so this cannot do better
+        LevelState *state = nodes.at(entry.index);
+        if (!keepSearching(int(frontier.size()), entry.fValue))
+            return best != NodeArena::NoNode;
+        if (level->goalReached(state)) {
+            best = entry.index;
+            bestCost = state->cost;
+            publishSolution(best, lowerBound(bestCost));
+        } else if (table.insertIfCheaper(state)) {
+            generateNextStates(state, nextStates);
+            for (LevelState &nextState : nextStates) {
+                int heuristic = level->getHeuristic(&nextState);
+                int fValue = nextState.cost + heuristic;
+                if (heuristic != -1 && fValue < bestCost)
+                    push({ nextState.cost * 100 + heuristic * weight, fValue, heuristic,
+                           nodes.allocate(nextState, entry.index) });
+            }
+        }
+    }
+    if (best == NodeArena::NoNode)
+        return false;
+    // either the open list ran out or weight 1 proved the bound
+    publishSolution(best, bestCost);
+    return true;
+}
+
+void AnytimeAStarSolver::push(const Entry &entry)
+{
+    frontier.push_back(entry);
+    std::push_heap(frontier.begin(), frontier.end(), comesAfter);
+}
+
+AnytimeAStarSolver::Entry AnytimeAStarSolver::pop()
+{
+    std::pop_heap(frontier.begin(), frontier.end(), comesAfter);
+    Entry entry = frontier.back();
+    frontier.pop_back();
+    return entry;
+}
+
+/*
+ * Recomputes every priority for a lower weight and restores the heap in
+ * linear time, so the states already generated are kept.
+ */
+void AnytimeAStarSolver::reorder(int newWeight)
+{
+    weight = newWeight;
+    for (Entry &entry : frontier)
+        entry.priority = (entry.fValue - entry.heuristic) * 100 + entry.heuristic * weight;
+    std::make_heap(frontier.begin(), frontier.end(), comesAfter);
+}
+
+int AnytimeAStarSolver::lowerBound(int bestCost) const
+{
+    int bound = bestCost;
+    for (const Entry &entry : frontier)
+        bound = qMin(bound, entry.fValue);
+    return bound;
+}
+
+// lowest priority first and, among equal ones, the closest to the goal
+bool AnytimeAStarSolver::comesAfter(const Entry &a, const Entry &b)
+{
+    return a.priority != b.priority ? a.priority > b.priority : a.heuristic > b.heuristic;
+}
+
+bool AnytimeAStarSolver::findsOptimalSolutions() const
+{
+    return true;
+}
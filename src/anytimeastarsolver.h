@@ -0,0 +1,50 @@
+#ifndef ANYTIMEASTARSOLVER_H
+#define ANYTIMEASTARSOLVER_H
+
+#include "abstractsolver.h"
+
+#include <vector>
+
+/*
+ * Anytime weighted A*. States are expanded by their cost plus a multiple of
+ * their heuristic, which finds some solution after far fewer expansions
+ * than A* does, and the solution is published right away. The weight is
+ * then lowered step by step down to 1, keeping the open list (reordered
+ * for the new weight) and the transposition table, and every cheaper
+ * solution found on the way is published too. States that cannot lead to
+ * a cheaper solution than the best one are dropped.
+ *
+ * With a weight w, once nothing in the open list is ordered before the
+ * best solution, that solution costs at most w times the optimum. At
+ * weight 1 that makes it optimal, as is any solution if the open list runs
+ * out. Each published solution comes with the best lower bound known at
+ * the time: the smallest unweighted f-value in the open list.
+ */
+
+class AnytimeAStarSolver : public AbstractSolver
+{
+public:
+    AnytimeAStarSolver(LevelFormat *format);
+protected:
+    bool solve() override;
+    bool findsOptimalSolutions() const override;
+private:
+    struct Entry
+    {
+        int priority; // cost plus the weighted heuristic, in hundredths
+        int fValue;
+        int heuristic;
+        quint32 index;
+    };
+
+    void push(const Entry &entry);
+    Entry pop();
+    void reorder(int weight);
+    int lowerBound(int bestCost) const;
+    static bool comesAfter(const Entry &a, const Entry &b);
+
+    std::vector<Entry> frontier; // a heap, see push()
+    int weight; // in hundredths
+};
+
+#endif // ANYTIMEASTARSOLVER_H
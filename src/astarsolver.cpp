@@ -1,80 +1,53 @@
 #include "astarsolver.h"
+#include "bucketqueue.h"
 #include "levelformat.h"
+#include "transpositiontable.h"
 
-#include <queue>
 #include <QtDebug>
 
 AStarSolver::AStarSolver(LevelFormat *format):
     AbstractSolver (format)
 {
-    solved = solve();
+
 }
 
 bool AStarSolver::solve()
 {
-    QHash<LevelState*, int> fValues;
-    QSet<LevelState*> pruned;
-    auto cmp = [&fValues](LevelState *a, LevelState *b) {
-        if (!fValues.contains(a)) {
-            return true; }
-        if (!fValues.contains(b)) {
-            return false;
-    }
-        return fValues.value(a) > fValues.value(b);
-    };
-    std::priority_queue<LevelState*, std::vector<LevelState*>, decltype (cmp)> frontier(cmp);
-    frontier.push(level->getInitialState());
-    fValues.insert(level->getInitialState(), level->getHeuristic(level->getInitialState()));
-    if (fValues.value(level->getInitialState()) == -1)
+    // lowest f first and, among equal f-values, the one the push distances
+    // put closest to the goal, which is usually the one furthest along its
+    // path, then the one generated last
+    BucketQueue frontier;
+    TranspositionTable table(level);
+    setMemoryProbe([&] { return table.bytesUsed() + frontier.bytesUsed(); });
+    QVector<LevelState> nextStates;
+    int initialHeuristic = level->getHeuristic(level->getInitialState());
+    if (initialHeuristic == -1)
         return false;
-    while (!frontier.empty()) {
-        LevelState *state = frontier.top();
-        frontier.pop();
-        if (pruned.contains(state))
-            continue;
-        else if (level->goalReached(state)) {
-            while (state->previousState) {
-                solution.prepend(state);
-                fValues.remove(state);
-                state = state->previousState;
-            }
-            solution.prepend(level->getInitialState());
-            fValues.remove(level->getInitialState());
-            for (LevelState *seenState : fValues.keys())
-                delete seenState;
-            solved = true;
+    frontier.push(nodes.allocate(*level->getInitialState(), NodeArena::NoNode), initialHeuristic, initialHeuristic);
+    while (!frontier.isEmpty()) {
+        int fValue = frontier.lowestPriority();
+        quint32 index = frontier.pop();
+        LevelState *state = nodes.at(index);
+        if (!keepSearching(frontier.size(), fValue))
+            return false;
+        if (level->goalReached(state)) {
+            buildSolution(index);
             return true;
-        } else {
-            bool isNewState = true;
-            int fValueForState = fValues.value(state);
-            for (LevelState *seenState : fValues.keys()) {
-                int fValueForSeenState = fValues.value(seenState);
-                if (level->similarTo(state, seenState, qAbs(fValueForState - fValueForSeenState)) && state != seenState) {
-                    if (fValueForState >= fValueForSeenState) {
-                        isNewState = false;
-                        break;
-                    } else
-                        pruned.insert(seenState);
-                }
-            }
-            if (isNewState) {
-                QSet<LevelState*> *nextStates = level->nextStatesFor(state);
-                QSet<LevelState*> admissibleNextStates;
-                if (nextStates) {
-                    for (LevelState *nextState : *nextStates) {
-                        int heuristic = level->getHeuristic(nextState);
-                        if (heuristic != -1) {
-                            fValues.insert(nextState, nextState->cost + heuristic);
-                            admissibleNextStates.insert(nextState);
-                        }
-                    }
-                    for (LevelState *nextState : admissibleNextStates)
-                        frontier.push(nextState);
-                }
+        } else if (table.insertIfCheaper(state)) {
+            // states with equal boxes have equal heuristics, so comparing
+            // costs is the same as comparing f-values
+            generateNextStates(state, nextStates);
+            for (LevelState &nextState : nextStates) {
+                int heuristic = level->getHeuristic(&nextState);
+                if (heuristic != -1)
+                    frontier.push(nodes.allocate(nextState, index), nextState.cost + heuristic, heuristic);
             }
         }
     }
-    for (LevelState *seenState : fValues.keys())
-        delete seenState;
     return false;
 }
+
+bool AStarSolver::findsOptimalSolutions() const
+{
+    return true;
+}
@@ -7,7 +7,9 @@ class AStarSolver : public AbstractSolver
 {
 public:
     AStarSolver(LevelFormat *format);
+protected:
     bool solve() override;
+    bool findsOptimalSolutions() const override;
 };
 
 #endif // ASTARSOLVER_H
@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Benchmark: solves the reference levels in
+# corpus.xsb with each solver under a time cap,
+# writes a JSON report and compares it against
+# a saved baseline.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = sokoban-bench
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += BENCH_CORPUS=\\\"$$PWD/corpus.xsb\\\"
+
+include(../core.pri)
+
+INCLUDEPATH += $$PWD/../cli
+
+SOURCES += \
+        main.cpp \
+    benchmarkreport.cpp \
+    ../cli/solverfactory.cpp
+
+HEADERS += \
+    benchmarkreport.h \
+    ../cli/solverfactory.h
+
+OTHER_FILES += \
+    corpus.xsb
@@ -0,0 +1,172 @@
+#include "benchmarkreport.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+namespace {
+
+// growth in time or memory below these is put down to measurement noise
+const qint64 TimeNoiseMilliseconds = 50;
+const qint64 MemoryNoiseBytes = 1024 * 1024;
+
+bool grewBeyond(qint64 value, qint64 baseline, double tolerance, qint64 noise = 0)
+{
+    return value - baseline > noise && value > baseline * (1 + tolerance);
+}
+
+}
+
+BenchmarkReport::BenchmarkReport() :
+    timeLimit(0)
+{
+
+}
+
+void BenchmarkReport::setSettings(const QString &corpus, qint64 timeLimit)
+{
+    this->corpus = corpus;
+    this->timeLimit = timeLimit;
+}
+
+void BenchmarkReport::add(const BenchmarkResult &result)
+{
+    entries.append(result);
+}
+
+const QList<BenchmarkResult> &BenchmarkReport::results() const
+{
+    return entries;
+}
+
+bool BenchmarkReport::save(const QString &fileName, QString *error) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(toJson()) == -1) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QByteArray BenchmarkReport::toJson() const
+{
+    QJsonArray results;
+    for (const BenchmarkResult &result : entries)
+        results.append(resultToJson(result));
+    QJsonObject report;
+    report["corpus"] = corpus;
+    report["timeLimitMs"] = double(timeLimit);
+    report["results"] = results;
+    return QJsonDocument(report).toJson();
+}
+
+bool BenchmarkReport::load(const QString &fileName, QString *error)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isObject()) {
+        if (error)
+            *error = parseError.errorString();
+        return false;
+    }
+    QJsonObject report = document.object();
+    corpus = report.value("corpus").toString();
+    timeLimit = qint64(report.value("timeLimitMs").toDouble());
+    entries.clear();
+    for (const QJsonValue &value : report.value("results").toArray())
+        entries.append(resultFromJson(value.toObject()));
+    return true;
+}
+
+/*
+ * Results are matched on level number and algorithm, so reports of
+ * different corpora or time limits should not be compared.
+ */
+int BenchmarkReport::compare(const BenchmarkReport &baseline, double tolerance, QTextStream &out) const
+{
+    int regressions = 0;
+    int improvements = 0;
+    int matched = 0;
+    for (const BenchmarkResult &result : entries) {
+        const BenchmarkResult *before = nullptr;
+        for (const BenchmarkResult &candidate : baseline.entries) {
+            if (candidate.level == result.level && candidate.algorithm == result.algorithm)
+                before = &candidate;
+        }
+        if (!before)
+            continue;
+        ++matched;
+        QStringList problems;
+        bool wasSolved = before->result == "solved";
+        bool isSolved = result.result == "solved";
+        if (before->result != result.result && (wasSolved || result.result == "crashed"))
+            problems << QString("%1 instead of %2").arg(result.result, before->result);
+        else if (isSolved && !wasSolved && before->result != "unsolvable")
+            ++improvements;
+        if (wasSolved && isSolved && result.moves > before->moves)
+            problems << QString("%1 moves instead of %2").arg(result.moves).arg(before->moves);
+        if (grewBeyond(result.nodesExpanded, before->nodesExpanded, tolerance))
+            problems << QString("%1 nodes expanded instead of %2").arg(result.nodesExpanded).arg(before->nodesExpanded);
+        if (grewBeyond(result.elapsedMilliseconds, before->elapsedMilliseconds, tolerance, TimeNoiseMilliseconds))
+            problems << QString("%1 ms instead of %2").arg(result.elapsedMilliseconds).arg(before->elapsedMilliseconds);
+        if (grewBeyond(result.peakRss, before->peakRss, tolerance, MemoryNoiseBytes))
+            problems << QString("%1 KiB peak RSS instead of %2").arg(result.peakRss / 1024).arg(before->peakRss / 1024);
+        if (!problems.isEmpty()) {
+            ++regressions;
+            out << "REGRESSION level " << result.level << " (" << result.title << "), " << result.algorithm
+                << ": " << problems.join(", ") << "\n";
+        }
+    }
+    out << matched << " results compared, " << regressions << " regressed, "
+        << improvements << " newly solved\n";
+    return regressions;
+}
+
+QJsonObject BenchmarkReport::resultToJson(const BenchmarkResult &result)
+{
+    QJsonObject object;
+    object["level"] = result.level;
+    object["title"] = result.title;
+    object["grade"] = result.grade;
+    object["boxes"] = result.boxes;
+    object["algorithm"] = result.algorithm;
+    object["result"] = result.result;
+    object["pushes"] = result.pushes;
+    object["moves"] = result.moves;
+    // JSON numbers are doubles, which hold these exactly
+    object["nodesExpanded"] = double(result.nodesExpanded);
+    object["nodesGenerated"] = double(result.nodesGenerated);
+    object["timeMs"] = double(result.elapsedMilliseconds);
+    object["nodesPerSecond"] = result.nodesPerSecond;
+    object["peakRssBytes"] = double(result.peakRss);
+    return object;
+}
+
+BenchmarkResult BenchmarkReport::resultFromJson(const QJsonObject &object)
+{
+    BenchmarkResult result;
+    result.level = object.value("level").toInt();
+    result.title = object.value("title").toString();
+    result.grade = object.value("grade").toString();
+    result.boxes = object.value("boxes").toInt();
+    result.algorithm = object.value("algorithm").toString();
+    result.result = object.value("result").toString();
+    result.pushes = object.value("pushes").toInt();
+    result.moves = object.value("moves").toInt();
+    result.nodesExpanded = qint64(object.value("nodesExpanded").toDouble());
+    result.nodesGenerated = qint64(object.value("nodesGenerated").toDouble());
+    result.elapsedMilliseconds = qint64(object.value("timeMs").toDouble());
+    result.nodesPerSecond = object.value("nodesPerSecond").toDouble();
+    result.peakRss = qint64(object.value("peakRssBytes").toDouble());
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <QList>
+#include <QString>
+
+class QJsonObject;
+class QTextStream;
+
+struct BenchmarkResult
+{
+    int level; // 1-based position in the corpus
+    QString title;
+    QString grade; // first word of the title
+    int boxes;
+    QString algorithm;
+    QString result; // solved, unsolvable, cancelled, timeout, memory, not run, invalid or crashed
+    int pushes;
+    int moves;
+    qint64 nodesExpanded;
+    qint64 nodesGenerated;
+    qint64 elapsedMilliseconds;
+    double nodesPerSecond;
+    qint64 peakRss; // bytes, of the process that ran the solve
+};
+
+/*
+ * The results of one benchmark run, saved as a JSON object with the run's
+ * settings and one entry per level and solver. compare() checks a report
+ * against a baseline from an earlier run: a result that is no longer
+ * solved or has a longer solution is always a regression, and one that
+ * expanded more nodes, took longer or used more memory is if it grew by
+ * more than the tolerance (and, for time and memory, by more than what
+ * is lost in measurement noise).
+ */
+
+class BenchmarkReport
+{
+public:
+    BenchmarkReport();
+
+    void setSettings(const QString &corpus, qint64 timeLimit);
+    void add(const BenchmarkResult &result);
+    const QList<BenchmarkResult> &results() const;
+
+    bool save(const QString &fileName, QString *error = nullptr) const;
+    QByteArray toJson() const;
+    bool load(const QString &fileName, QString *error = nullptr);
+    // writes one line per regression and a summary, returns the number
+    // of regressions; tolerance is a fraction, 0.2 allows 20% growth
+    int compare(const BenchmarkReport &baseline, double tolerance, QTextStream &out) const;
+
+    static QJsonObject resultToJson(const BenchmarkResult &result);
+    static BenchmarkResult resultFromJson(const QJsonObject &object);
+private:
+    QString corpus;
+    qint64 timeLimit; // milliseconds
+    QList<BenchmarkResult> entries;
+};
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,262 @@
+#include "abstractsolver.h"
+#include "benchmarkreport.h"
+#include "levelcollection.h"
+#include "solverfactory.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// how long a child may take past the time cap to exit on its own
+const int GraceMilliseconds = 5000;
+
+qint64 peakRss()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef Q_OS_MAC
+    return qint64(usage.ru_maxrss); // bytes
+#else
+    return qint64(usage.ru_maxrss) * 1024; // KiB
+#endif
+#else
+    return 0;
+#endif
+}
+
+BenchmarkResult emptyResult(int levelNumber, const QString &title, const QString &algorithm)
+{
+    BenchmarkResult result;
+    result.level = levelNumber;
+    result.title = title;
+    result.grade = title.section(' ', 0, 0).toLower();
+    result.boxes = 0;
+    result.algorithm = algorithm;
+    result.result = "invalid";
+    result.pushes = 0;
+    result.moves = 0;
+    result.nodesExpanded = 0;
+    result.nodesGenerated = 0;
+    result.elapsedMilliseconds = 0;
+    result.nodesPerSecond = 0;
+    result.peakRss = 0;
+    return result;
+}
+
+}
+
+/*
+ * Solves a single level in this process and prints its result as one line
+ * of JSON. The parent runs every solve in a child of its own, so the peak
+ * RSS measured is that solve's alone, and a crash only loses one result.
+ */
+static int runOne(const QString &corpus, int levelNumber, const QString &algorithm, qint64 timeLimit)
+{
+    QTextStream out(stdout);
+    LevelCollection collection;
+    if (!collection.open(corpus))
+        return 2;
+    while (collection.levelNumber() + 1 < levelNumber && collection.skip()) {}
+    if (!collection.hasNext())
+        return 2;
+    QString error;
+    LevelFormat *format = collection.next(&error);
+    BenchmarkResult result = emptyResult(levelNumber, collection.title(), algorithm);
+    if (format) {
+        result.boxes = format->getInitialState()->movables.count();
+        AbstractSolver *solver = createSolver(algorithm, format, 0, 0);
+        solver->setTimeLimit(timeLimit);
+        solver->run();
+        SolveStatistics statistics = solver->statistics();
+        switch (solver->outcome()) {
+        case AbstractSolver::Solved: result.result = "solved"; break;
+        case AbstractSolver::NoSolution: result.result = "unsolvable"; break;
+        case AbstractSolver::Cancelled: result.result = "cancelled"; break;
+        case AbstractSolver::TimedOut: result.result = "timeout"; break;
+        case AbstractSolver::OutOfMemory: result.result = "memory"; break;
+        case AbstractSolver::NotRun: result.result = "not run"; break;
+        }
+        QString moves = solver->getSolutionMoves();
+        result.moves = moves.size();
+        for (QChar move : moves)
+            result.pushes += move.isUpper() ? 1 : 0;
+        result.nodesExpanded = statistics.nodesExpanded;
+        result.nodesGenerated = statistics.nodesGenerated;
+        result.elapsedMilliseconds = statistics.elapsedMilliseconds;
+        if (statistics.elapsedMilliseconds > 0)
+            result.nodesPerSecond = statistics.nodesExpanded * 1000.0 / statistics.elapsedMilliseconds;
+        delete solver;
+        delete format;
+    }
+    result.peakRss = peakRss();
+    out << QJsonDocument(BenchmarkReport::resultToJson(result)).toJson(QJsonDocument::Compact) << "\n";
+    return 0;
+}
+
+static BenchmarkResult runChild(const QString &corpus, int levelNumber, const QString &title,
+                                const QString &algorithm, qint64 timeLimit)
+{
+    BenchmarkResult result = emptyResult(levelNumber, title, algorithm);
+    QProcess child;
+    child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    child.start(QCoreApplication::applicationFilePath(),
+                QStringList() << "--run" << QString::number(levelNumber) << "-a" << algorithm
+                << "-t" << QString::number(timeLimit / 1000.0) << corpus);
+    if (!child.waitForFinished(int(timeLimit) + GraceMilliseconds)) {
+        child.kill();
+        child.waitForFinished();
+        result.result = "timeout";
+        result.elapsedMilliseconds = timeLimit;
+        return result;
+    }
+    QJsonDocument document = QJsonDocument::fromJson(child.readAllStandardOutput());
+    if (child.exitStatus() != QProcess::NormalExit || child.exitCode() != 0 || !document.isObject()) {
+        result.result = "crashed";
+        return result;
+    }
+    return BenchmarkReport::resultFromJson(document.object());
+}
+
+static void writeSummary(const BenchmarkReport &report, const QStringList &algorithms, QTextStream &out)
+{
+    QStringList grades;
+    for (const BenchmarkResult &result : report.results()) {
+        if (!grades.contains(result.grade))
+            grades.append(result.grade);
+    }
+    for (const QString &algorithm : algorithms) {
+        for (const QString &grade : grades) {
+            int levels = 0;
+            int solved = 0;
+            qint64 nodes = 0;
+            qint64 time = 0;
+            qint64 memory = 0;
+            for (const BenchmarkResult &result : report.results()) {
+                if (result.algorithm != algorithm || result.grade != grade)
+                    continue;
+                ++levels;
+                solved += result.result == "solved" ? 1 : 0;
+                nodes += result.nodesExpanded;
+                time += result.elapsedMilliseconds;
+                memory = qMax(memory, result.peakRss);
+            }
+            out << algorithm << " " << grade << ": " << solved << "/" << levels << " solved, "
+                << nodes << " nodes expanded, " << time << " ms, "
+                << memory / (1024 * 1024) << " MiB peak RSS\n";
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sokoban-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Solves a corpus of reference levels with each solver and reports the results.");
+    parser.addHelpOption();
+    QCommandLineOption algorithmsOption(QStringList() << "a" << "algorithms",
+                                        "Comma-separated solvers to run: " + solverNames().join(", ") + ". Defaults to astar.",
+                                        "names", solverNames().first());
+    parser.addOption(algorithmsOption);
+    QCommandLineOption timeLimitOption(QStringList() << "t" << "time-limit",
+                                       "Give up on a level after this many seconds (default 60).",
+                                       "seconds", "60");
+    parser.addOption(timeLimitOption);
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Write the JSON report to this file instead of standard output.",
+                                    "file");
+    parser.addOption(outputOption);
+    QCommandLineOption compareOption(QStringList() << "c" << "compare",
+                                     "Compare against a baseline report and exit with 1 if anything regressed.",
+                                     "file");
+    parser.addOption(compareOption);
+    QCommandLineOption toleranceOption(QStringList() << "tolerance",
+                                       "How much node counts, time and memory may grow over the baseline, in percent (default 20).",
+                                       "percent", "20");
+    parser.addOption(toleranceOption);
+    QCommandLineOption runOption(QStringList() << "run", "Solve only this level and print its result (used internally).",
+                                 "number");
+    runOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(runOption);
+    parser.addPositionalArgument("corpus", "Level collection to benchmark (default: the bundled corpus.xsb).");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QStringList algorithms;
+    for (const QString &algorithm : parser.value(algorithmsOption).split(',')) {
+        if (algorithm.isEmpty())
+            continue;
+        if (!solverNames().contains(algorithm)) {
+            err << "Unknown algorithm " << algorithm << "\n";
+            return 2;
+        }
+        algorithms << algorithm;
+    }
+    qint64 timeLimit = qint64(parser.value(timeLimitOption).toDouble() * 1000);
+    QString corpus = parser.positionalArguments().value(0, BENCH_CORPUS);
+    if (parser.isSet(runOption))
+        return runOne(corpus, parser.value(runOption).toInt(), algorithms.value(0), timeLimit);
+    if (timeLimit <= 0) {
+        err << "The time limit must be positive\n";
+        return 2;
+    }
+
+    LevelCollection collection;
+    if (!collection.open(corpus)) {
+        err << "Cannot open " << corpus << ": " << collection.errorString() << "\n";
+        return 2;
+    }
+    QList<QString> titles;
+    while (collection.skip())
+        titles.append(collection.title());
+
+    BenchmarkReport report;
+    report.setSettings(corpus, timeLimit);
+    for (const QString &algorithm : algorithms) {
+        for (int i = 0; i < titles.size(); ++i) {
+            BenchmarkResult result = runChild(corpus, i + 1, titles.at(i), algorithm, timeLimit);
+            err << algorithm << " " << i + 1 << " " << result.title << ": " << result.result
+                << ", " << result.elapsedMilliseconds << " ms\n";
+            err.flush();
+            report.add(result);
+        }
+    }
+    writeSummary(report, algorithms, err);
+
+    if (parser.isSet(outputOption)) {
+        QString error;
+        if (!report.save(parser.value(outputOption), &error)) {
+            err << "Cannot write " << parser.value(outputOption) << ": " << error << "\n";
+            return 2;
+        }
+    } else {
+        out << report.toJson();
+        out.flush();
+    }
+
+    if (!parser.isSet(compareOption))
+        return 0;
+    BenchmarkReport baseline;
+    QString error;
+    if (!baseline.load(parser.value(compareOption), &error)) {
+        err << "Cannot read " << parser.value(compareOption) << ": " << error << "\n";
+        return 2;
+    }
+    double tolerance = parser.value(toleranceOption).toDouble() / 100;
+    return report.compare(baseline, tolerance, err) > 0 ? 1 : 0;
+}
@@ -1,5 +1,6 @@
 #include "bfssolver.h"
 #include "levelformat.h"
+#include "transpositiontable.h"
 
 #include <QQueue>
 #include <QtDebug>
@@ -7,52 +8,30 @@
 BFSSolver::BFSSolver(LevelFormat *format):
     AbstractSolver (format)
 {
-    solved = solve();
+
 }
 
 bool BFSSolver::solve()
 {
-    QSet<LevelState *> seen;
-    QQueue<LevelState*> frontier;
-    frontier.enqueue(level->getInitialState());
+    TranspositionTable table(level);
+    QQueue<quint32> frontier;
+    // a QList keeps every entry in a pointer-sized slot
+    setMemoryProbe([&] { return table.bytesUsed() + qint64(frontier.size()) * qint64(sizeof(void *)); });
+    QVector<LevelState> nextStates;
+    frontier.enqueue(nodes.allocate(*level->getInitialState(), NodeArena::NoNode));
     while (!frontier.isEmpty()) {
-        LevelState *state = frontier.dequeue();
+        quint32 index = frontier.dequeue();
+        LevelState *state = nodes.at(index);
+        if (!keepSearching(frontier.size()))
+            return false;
         if (level->goalReached(state)) {
-            while (state->previousState) {
-                solution.prepend(state);
-                seen.remove(state);
-                state = state->previousState;
-            }
-            solution.prepend(level->getInitialState());
-            seen.remove(level->getInitialState());
-            for (LevelState *seenState : seen)
-                delete seenState;
-            for (LevelState *queuedState : frontier)
-                delete queuedState;
-            solved = true;
+            buildSolution(index);
             return true;
-        } else {
-            bool isNewState = true;
-            for (LevelState *seenState : seen) {
-                if (level->similarTo(state, seenState)) {
-                    isNewState = false;
-                    break;
-                }
-            }
-            seen.insert(state);
-            if (isNewState) {
-                QSet<LevelState*> *nextStates = level->nextStatesFor(state);
-                if (nextStates) {
-                    for (LevelState *nextState : *nextStates) {
-                        frontier.enqueue(nextState);
-                    }
-                }
-            }
+        } else if (table.insert(state)) {
+            generateNextStates(state, nextStates);
+            for (const LevelState &nextState : nextStates)
+                frontier.enqueue(nodes.allocate(nextState, index));
         }
     }
-    for (LevelState *seenState : seen)
-        delete seenState;
-    for (LevelState *queuedState : frontier)
-        delete queuedState;
     return false;
 }
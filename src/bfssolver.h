@@ -7,6 +7,7 @@ class BFSSolver : public AbstractSolver
 {
 public:
     BFSSolver(LevelFormat *format);
+protected:
     bool solve() override;
 };
 
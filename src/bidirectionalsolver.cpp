@@ -0,0 +1,119 @@
+#include "bidirectionalsolver.h"
+
+BidirectionalSolver::BidirectionalSolver(LevelFormat *format) :
+    AbstractSolver (format)
+{
+
+}
+
+bool BidirectionalSolver::solve()
+{
+    LevelState *initialState = level->getInitialState();
+    QVector<LevelState> goalStates = level->goalStates();
+    if (goalStates.isEmpty() || goalStates.first().movables.count() != initialState->movables.count())
+        return false; // pulling from the goals would not give the same boxes
+    Side forward;
+    Side backward;
+    setMemoryProbe([&] { return bytesUsed(forward) + bytesUsed(backward); });
+    // both searches keep their nodes in the same arena, with the backward
+    // ones linked to the state one push closer to the goal
+    quint32 root = nodes.allocate(*initialState, NodeArena::NoNode);
+    forward.frontier.enqueue(root);
+    forward.seen.insert(level->keyFor(nodes.at(root)), root);
+    for (const LevelState &goalState : goalStates) {
+        quint32 index = nodes.allocate(goalState, NodeArena::NoNode);
+        StateKey key = level->keyFor(nodes.at(index));
+        if (backward.seen.contains(key))
+            continue;
+        backward.frontier.enqueue(index);
+        backward.seen.insert(key, index);
+    }
+    quint32 backwardRoot = backward.seen.value(level->keyFor(nodes.at(root)), NodeArena::NoNode);
+    if (backwardRoot != NodeArena::NoNode) {
+        buildJoinedSolution(root, backwardRoot);
+        return true;
+    }
+
+    quint32 forwardMeeting = NodeArena::NoNode;
+    quint32 backwardMeeting = NodeArena::NoNode;
+    while (!forward.frontier.isEmpty() && !backward.frontier.isEmpty()) {
+        bool forwards = forward.frontier.size() <= backward.frontier.size();
+        bool searching = forwards ? expandLayer(forward, backward, true, &forwardMeeting, &backwardMeeting)
+                                  : expandLayer(backward, forward, false, &forwardMeeting, &backwardMeeting);
+        if (forwardMeeting != NodeArena::NoNode) {
+            buildJoinedSolution(forwardMeeting, backwardMeeting);
+            return true;
+        }
+        if (!searching)
+            return false;
+    }
+    // one side ran out of states, so no state can be reached from both
+    return false;
+}
+
+/*
+ * Expands every state in the side's frontier that is as many pushes away
+ * from its roots as the first one.
+ */
+bool BidirectionalSolver::expandLayer(Side &side, const Side &other, bool forwards, quint32 *forwardMeeting,
+                                      quint32 *backwardMeeting)
+{
+    for (int layerSize = side.frontier.size(); layerSize > 0; --layerSize) {
+        quint32 index = side.frontier.dequeue();
+        if (!keepSearching(side.frontier.size() + other.frontier.size()))
+            return false;
+        if (forwards)
+            generateNextStates(nodes.at(index), nextStates);
+        else
+            level->previousStatesFor(nodes.at(index), nextStates);
+        for (LevelState &nextState : nextStates) {
+            // pulling boxes cannot get them stuck, but pushing can
+            if (forwards && level->getHeuristic(&nextState) == -1)
+                continue;
+            StateKey key = level->keyFor(&nextState);
+            if (side.seen.contains(key))
+                continue;
+            quint32 nextIndex = nodes.allocate(nextState, index);
+            quint32 otherIndex = other.seen.value(key, NodeArena::NoNode);
+            if (otherIndex != NodeArena::NoNode) {
+                *forwardMeeting = forwards ? nextIndex : otherIndex;
+                *backwardMeeting = forwards ? otherIndex : nextIndex;
+                return true;
+            }
+            side.seen.insert(key, nextIndex);
+            side.frontier.enqueue(nextIndex);
+        }
+    }
+    return true;
+}
+
+/*
+ * The forward half ends at a state the backward half started from with
+ * the player somewhere in the same area. Each state of the backward half
+ * is what pushing the box back from its parent gave, so replaying the
+ * pulls as pushes leaves the player where the box was, and the moves are
+ * counted again the way they are made.
+ */
+void BidirectionalSolver::buildJoinedSolution(quint32 forwardIndex, quint32 backwardIndex)
+{
+    quint32 index = forwardIndex;
+    for (quint32 pulled = nodes.at(backwardIndex)->previousState; pulled != NodeArena::NoNode;
+         pulled = nodes.at(pulled)->previousState) {
+        LevelState *from = nodes.at(index);
+        LevelState pushed = *nodes.at(pulled);
+        pushed.player = (from->movables & ~pushed.movables).first();
+        pushed.cost = from->cost + level->movesBetween(from, &pushed).size();
+        index = nodes.allocate(pushed, index);
+    }
+    buildSolution(index);
+}
+
+qint64 BidirectionalSolver::bytesUsed(const Side &side)
+{
+    // a hash node per state seen, a pointer per hash bucket, and a
+    // pointer-sized QList slot per frontier entry
+    const qint64 nodeBytes = sizeof(void *) + sizeof(uint) + sizeof(StateKey) + sizeof(quint32);
+    return qint64(side.seen.capacity()) * qint64(sizeof(void *))
+            + qint64(side.seen.size()) * nodeBytes
+            + qint64(side.frontier.size()) * qint64(sizeof(void *));
+}
@@ -0,0 +1,47 @@
+#ifndef BIDIRECTIONALSOLVER_H
+#define BIDIRECTIONALSOLVER_H
+
+#include "abstractsolver.h"
+#include "levelformat.h"
+
+#include <QHash>
+#include <QQueue>
+#include <QVector>
+
+/*
+ * Searches breadth-first from both ends at once: forwards from the start
+ * by pushing boxes, and backwards from every goal configuration by pulling
+ * them. Each step grows whichever side has the smaller frontier by one
+ * layer of pushes, and the search ends as soon as a state is reached from
+ * both sides, which happens long before either search alone would get
+ * there. The two halves are then joined into one solution.
+ *
+ * States are matched on their keys, so either side may reach a state with
+ * the player anywhere in its area. The solution has close to the fewest
+ * pushes, but its moves are not optimised.
+ */
+
+class BidirectionalSolver : public AbstractSolver
+{
+public:
+    BidirectionalSolver(LevelFormat *format);
+protected:
+    bool solve() override;
+private:
+    struct Side
+    {
+        QQueue<quint32> frontier;
+        QHash<StateKey, quint32> seen; // node of every state reached
+    };
+
+    // returns false if the search should stop, which it also should once
+    // the forward and backward nodes of a state both sides reached are set
+    bool expandLayer(Side &side, const Side &other, bool forwards, quint32 *forwardMeeting,
+                     quint32 *backwardMeeting);
+    void buildJoinedSolution(quint32 forwardIndex, quint32 backwardIndex);
+    static qint64 bytesUsed(const Side &side); // an estimate, like TranspositionTable::bytesUsed()
+
+    QVector<LevelState> nextStates;
+};
+
+#endif // BIDIRECTIONALSOLVER_H
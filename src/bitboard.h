@@ -0,0 +1,186 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+/*
+ * Fixed-width set of cells of a level, indexed by the linearized cell
+ * index handed out by LevelFormat (row * width + column). Used for walls,
+ * goals and boxes so that membership tests, goal checks and state equality
+ * are a handful of word operations with no allocation.
+ */
+
+class Bitboard
+{
+public:
+    static const int MaxCells = 512;
+    static const int Words = MaxCells / 64;
+
+    Bitboard();
+
+    bool test(int cell) const;
+    void set(int cell);
+    void reset(int cell);
+
+    bool any() const;
+    bool none() const;
+    int count() const;
+    int first() const; // -1 if empty
+    int next(int cell) const; // first cell after the given one, -1 if none
+    bool contains(const Bitboard &other) const; // every cell of other is set here
+
+    bool operator==(const Bitboard &other) const;
+    bool operator!=(const Bitboard &other) const;
+    Bitboard operator&(const Bitboard &other) const;
+    Bitboard operator|(const Bitboard &other) const;
+    Bitboard operator~() const;
+    Bitboard &operator&=(const Bitboard &other);
+    Bitboard &operator|=(const Bitboard &other);
+
+    quint64 word(int index) const;
+    void setWord(int index, quint64 value);
+private:
+    quint64 words[Words];
+};
+
+inline Bitboard::Bitboard()
+{
+    for (int i = 0; i < Words; ++i)
+        words[i] = 0;
+}
+
+inline bool Bitboard::test(int cell) const
+{
+    return (words[cell >> 6] >> (cell & 63)) & 1;
+}
+
+inline void Bitboard::set(int cell)
+{
+    words[cell >> 6] |= quint64(1) << (cell & 63);
+}
+
+inline void Bitboard::reset(int cell)
+{
+    words[cell >> 6] &= ~(quint64(1) << (cell & 63));
+}
+
+inline bool Bitboard::any() const
+{
+    quint64 merged = 0;
+    for (int i = 0; i < Words; ++i)
+        merged |= words[i];
+    return merged != 0;
+}
+
+inline bool Bitboard::none() const
+{
+    return !any();
+}
+
+inline int Bitboard::count() const
+{
+    int total = 0;
+    for (int i = 0; i < Words; ++i)
+        total += qPopulationCount(words[i]);
+    return total;
+}
+
+inline int Bitboard::first() const
+{
+    for (int i = 0; i < Words; ++i) {
+        if (words[i])
+            return (i << 6) + qCountTrailingZeroBits(words[i]);
+    }
+    return -1;
+}
+
+inline int Bitboard::next(int cell) const
+{
+    ++cell;
+    if (cell >= MaxCells)
+        return -1;
+    int i = cell >> 6;
+    quint64 remaining = words[i] & (~quint64(0) << (cell & 63));
+    while (!remaining) {
+        if (++i == Words)
+            return -1;
+        remaining = words[i];
+    }
+    return (i << 6) + qCountTrailingZeroBits(remaining);
+}
+
+inline bool Bitboard::contains(const Bitboard &other) const
+{
+    quint64 missing = 0;
+    for (int i = 0; i < Words; ++i)
+        missing |= other.words[i] & ~words[i];
+    return missing == 0;
+}
+
+inline bool Bitboard::operator==(const Bitboard &other) const
+{
+    quint64 difference = 0;
+    for (int i = 0; i < Words; ++i)
+        difference |= words[i] ^ other.words[i];
+    return difference == 0;
+}
+
+inline bool Bitboard::operator!=(const Bitboard &other) const
+{
+    return !(*this == other);
+}
+
+inline Bitboard Bitboard::operator&(const Bitboard &other) const
+{
+    Bitboard result(*this);
+    return result &= other;
+}
+
+inline Bitboard Bitboard::operator|(const Bitboard &other) const
+{
+    Bitboard result(*this);
+    return result |= other;
+}
+
+inline Bitboard Bitboard::operator~() const
+{
+    Bitboard result;
+    for (int i = 0; i < Words; ++i)
+        result.words[i] = ~words[i];
+    return result;
+}
+
+inline Bitboard &Bitboard::operator&=(const Bitboard &other)
+{
+    for (int i = 0; i < Words; ++i)
+        words[i] &= other.words[i];
+    return *this;
+}
+
+inline Bitboard &Bitboard::operator|=(const Bitboard &other)
+{
+    for (int i = 0; i < Words; ++i)
+        words[i] |= other.words[i];
+    return *this;
+}
+
+inline quint64 Bitboard::word(int index) const
+{
+    return words[index];
+}
+
+inline void Bitboard::setWord(int index, quint64 value)
+{
+    words[index] = value;
+}
+
+inline uint qHash(const Bitboard &key)
+{
+    quint64 hash = 0;
+    for (int i = 0; i < Bitboard::Words; ++i)
+        hash = (hash ^ key.word(i)) * Q_UINT64_C(0x100000001b3);
+    return uint(hash ^ (hash >> 32));
+}
+
+#endif // BITBOARD_H
@@ -0,0 +1,172 @@
+#include "boxmatching.h"
+
+#include <algorithm>
+
+namespace {
+
+// larger than any reduced cost, but safe to subtract from
+const int Infinity = 1 << 30;
+
+}
+
+const quint16 BoxMatching::Unreachable;
+
+BoxMatching::BoxMatching() :
+    distances(nullptr),
+    size(0),
+    solved(false),
+    totalCost(-1)
+{
+
+}
+
+BoxMatching::BoxMatching(const quint16 *distances, int goalCount) :
+    distances(distances),
+    size(goalCount),
+    solved(false),
+    totalCost(-1),
+    rowCells(goalCount + 1),
+    rowPotentials(goalCount + 1),
+    columnPotentials(goalCount + 1),
+    columnRows(goalCount + 1),
+    slack(goalCount + 1),
+    previousColumn(goalCount + 1),
+    visited(goalCount + 1)
+{
+
+}
+
+void BoxMatching::solve(const Bitboard &movables)
+{
+    boxes = movables;
+    solved = false;
+    totalCost = -1;
+    if (movables.count() > size)
+        return;
+    int row = 1;
+    for (int movable = movables.first(); movable != -1; movable = movables.next(movable))
+        rowCells[row++] = movable;
+    for (; row <= size; ++row)
+        rowCells[row] = -1;
+    std::fill(rowPotentials.begin(), rowPotentials.end(), 0);
+    std::fill(columnPotentials.begin(), columnPotentials.end(), 0);
+    std::fill(columnRows.begin(), columnRows.end(), 0);
+    for (row = 1; row <= size; ++row)
+        augment(row);
+    solved = true;
+    sumCost();
+}
+
+/*
+ * Each moved box gives up its goal, and its row potential is lowered just
+ * enough for every reduced cost in the row to be non-negative again. The
+ * other rows are untouched and stay tight on their goals, so augmenting
+ * from the moved rows alone restores an optimal matching.
+ */
+bool BoxMatching::update(const Bitboard &movables)
+{
+    if (!solved)
+        return false;
+    Bitboard removed = boxes & ~movables;
+    Bitboard added = movables & ~boxes;
+    int moved = removed.count();
+    if (moved != added.count() || moved * 2 > size)
+        return false;
+    int movedRows[Bitboard::MaxCells];
+    int movedCount = 0;
+    for (int from = removed.first(), to = added.first(); from != -1; from = removed.next(from), to = added.next(to)) {
+        int row = 1;
+        while (rowCells[row] != from)
+            ++row;
+        for (int column = 1; column <= size; ++column) {
+            if (columnRows[column] == row)
+                columnRows[column] = 0;
+        }
+        rowCells[row] = to;
+        int potential = Infinity;
+        for (int column = 1; column <= size; ++column)
+            potential = std::min(potential, costAt(row, column) - columnPotentials[column]);
+        rowPotentials[row] = potential;
+        movedRows[movedCount++] = row;
+    }
+    for (int i = 0; i < movedCount; ++i)
+        augment(movedRows[i]);
+    boxes = movables;
+    sumCost();
+    return true;
+}
+
+int BoxMatching::cost() const
+{
+    return totalCost;
+}
+
+const Bitboard &BoxMatching::movables() const
+{
+    return boxes;
+}
+
+int BoxMatching::costAt(int row, int column) const
+{
+    int cell = rowCells[row];
+    return cell == -1 ? 0 : distances[cell * size + column - 1];
+}
+
+/*
+ * Matches a free row through the shortest augmenting path in terms of
+ * reduced costs, growing it one column at a time like Dijkstra's
+ * algorithm and shifting the potentials as it goes.
+ */
+void BoxMatching::augment(int row)
+{
+    columnRows[0] = row;
+    int column = 0;
+    std::fill(slack.begin(), slack.end(), Infinity);
+    std::fill(visited.begin(), visited.end(), 0);
+    do {
+        visited[column] = 1;
+        int current = columnRows[column];
+        int delta = Infinity;
+        int nextColumn = 0;
+        for (int j = 1; j <= size; ++j) {
+            if (visited[j])
+                continue;
+            int reduced = costAt(current, j) - rowPotentials[current] - columnPotentials[j];
+            if (reduced < slack[j]) {
+                slack[j] = reduced;
+                previousColumn[j] = column;
+            }
+            if (slack[j] < delta) {
+                delta = slack[j];
+                nextColumn = j;
+            }
+        }
+        for (int j = 0; j <= size; ++j) {
+            if (visited[j]) {
+                rowPotentials[columnRows[j]] += delta;
+                columnPotentials[j] -= delta;
+            } else {
+                slack[j] -= delta;
+            }
+        }
+        column = nextColumn;
+    } while (columnRows[column] != 0);
+    do {
+        int previous = previousColumn[column];
+        columnRows[column] = columnRows[previous];
+        column = previous;
+    } while (column != 0);
+}
+
+void BoxMatching::sumCost()
+{
+    totalCost = 0;
+    for (int column = 1; column <= size; ++column) {
+        int distance = costAt(columnRows[column], column);
+        if (distance >= Unreachable) {
+            totalCost = -1;
+            return;
+        }
+        totalCost += distance;
+    }
+}
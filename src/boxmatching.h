@@ -0,0 +1,63 @@
+#ifndef BOXMATCHING_H
+#define BOXMATCHING_H
+
+#include "bitboard.h"
+
+#include <vector>
+
+/*
+ * Assigns every box its own goal so that the total number of pushes is as
+ * small as possible, using the Hungarian algorithm on a table of push
+ * distances. Since every box still has to make at least that many pushes,
+ * the total is a lower bound on the moves left, and if some box can only
+ * be matched to a goal it cannot reach, the state is dead.
+ *
+ * Solving from scratch takes cubic time in the number of goals, but the
+ * matching of a state is usually needed right after that of a state with
+ * a single box in another place. update() then only frees the moved
+ * box's goal and finds one augmenting path, which takes quadratic time.
+ * The potentials stay feasible through such a change, so the result is
+ * still optimal.
+ */
+
+class BoxMatching
+{
+public:
+    static const quint16 Unreachable = 0xffff; // distance from a cell a goal cannot be reached from
+
+    BoxMatching();
+    // distances holds goalCount entries per cell, and must outlive the matching
+    BoxMatching(const quint16 *distances, int goalCount);
+
+    void solve(const Bitboard &movables);
+    // moves the boxes that differ from the current ones, returns false
+    // without changing anything if so many moved that solve() is cheaper
+    bool update(const Bitboard &movables);
+
+    int cost() const; // -1 if some box cannot get to a goal of its own
+    const Bitboard &movables() const;
+private:
+    int costAt(int row, int column) const;
+    void augment(int row);
+    void sumCost();
+
+    const quint16 *distances;
+    int size; // one row per box, padded to one per goal with rows that cost nothing
+    bool solved;
+    Bitboard boxes;
+    int totalCost;
+
+    // the rows and columns are numbered from 1, column 0 stands for the
+    // row being added while augmenting
+    std::vector<int> rowCells; // -1 for padding
+    std::vector<int> rowPotentials;
+    std::vector<int> columnPotentials;
+    std::vector<int> columnRows; // 0 if free
+
+    // only used while augmenting, kept to avoid allocations
+    std::vector<int> slack;
+    std::vector<int> previousColumn;
+    std::vector<char> visited;
+};
+
+#endif // BOXMATCHING_H
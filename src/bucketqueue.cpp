@@ -0,0 +1,82 @@
+#include "bucketqueue.h"
+
+BucketQueue::BucketQueue() :
+    lowest(0),
+    count(0),
+    reservedBytes(0)
+{
+
+}
+
+void BucketQueue::push(quint32 index, int priority, int tieBreak)
+{
+    Bucket &bucket = bucketFor(priority);
+    if (tieBreak >= bucket.stacks.size()) {
+        reservedBytes += qint64(tieBreak + 1 - bucket.stacks.size()) * qint64(sizeof(QVector<quint32>));
+        bucket.stacks.resize(tieBreak + 1);
+    }
+    if (bucket.count == 0 || tieBreak < bucket.lowestStack)
+        bucket.lowestStack = tieBreak;
+    QVector<quint32> &stack = bucket.stacks[tieBreak];
+    int capacity = stack.capacity();
+    stack.append(index);
+    reservedBytes += qint64(stack.capacity() - capacity) * qint64(sizeof(quint32));
+    ++bucket.count;
+    if (count == 0 || priority < lowest)
+        lowest = priority;
+    ++count;
+}
+
+/*
+ * The cursors only move forwards here, and push() moves them back when
+ * something goes before them, so with consistent priorities (never lower
+ * than the last one popped) every empty stack is stepped over once.
+ */
+quint32 BucketQueue::pop()
+{
+    while (buckets.at(lowest).count == 0)
+        ++lowest;
+    Bucket &bucket = buckets[lowest];
+    while (bucket.stacks.at(bucket.lowestStack).isEmpty())
+        ++bucket.lowestStack;
+    QVector<quint32> &stack = bucket.stacks[bucket.lowestStack];
+    quint32 index = stack.last();
+    stack.removeLast();
+    --bucket.count;
+    --count;
+    return index;
+}
+
+bool BucketQueue::isEmpty() const
+{
+    return count == 0;
+}
+
+int BucketQueue::size() const
+{
+    return count;
+}
+
+int BucketQueue::lowestPriority() const
+{
+    if (count == 0)
+        return -1;
+    int priority = lowest;
+    while (buckets.at(priority).count == 0)
+        ++priority;
+    return priority;
+}
+
+qint64 BucketQueue::bytesUsed() const
+{
+    return reservedBytes;
+}
+
+BucketQueue::Bucket &BucketQueue::bucketFor(int priority)
+{
+    if (priority >= buckets.size()) {
+        reservedBytes += qint64(priority + 1 - buckets.size()) * qint64(sizeof(Bucket));
+        buckets.resize(priority + 1);
+    }
+    return buckets[priority];
+}
@@ -0,0 +1,42 @@
+#ifndef BUCKETQUEUE_H
+#define BUCKETQUEUE_H
+
+#include <QVector>
+
+/*
+ * Open list for priorities that are small non-negative integers, such as
+ * f-values and costs. Node indices are kept in one stack per priority and,
+ * inside it, per tie-break value, so pushing and popping take constant
+ * time apart from stepping over empty stacks, and nothing is compared.
+ * The lowest priority comes first, then the lowest tie-break value, then
+ * the entry pushed last, which is usually the one deepest in the search.
+ */
+
+class BucketQueue
+{
+public:
+    BucketQueue();
+
+    void push(quint32 index, int priority, int tieBreak = 0);
+    quint32 pop();
+    bool isEmpty() const;
+    int size() const;
+    int lowestPriority() const; // of the entry pop() returns next, -1 if empty
+    qint64 bytesUsed() const; // reserved by the stacks, which never shrink
+private:
+    struct Bucket
+    {
+        QVector<QVector<quint32>> stacks; // by tie-break value
+        int lowestStack = 0; // no entries in the stacks before it
+        int count = 0;
+    };
+
+    Bucket &bucketFor(int priority);
+
+    QVector<Bucket> buckets; // by priority
+    int lowest; // no entries in the buckets before it
+    int count;
+    qint64 reservedBytes;
+};
+
+#endif // BUCKETQUEUE_H
@@ -0,0 +1,59 @@
+#include "batchtask.h"
+#include "abstractsolver.h"
+#include "batchwriter.h"
+#include "levelformat.h"
+#include "solverfactory.h"
+
+BatchTask::BatchTask(LevelFormat *format, int levelNumber, const QString &title, const QString &algorithm,
+                     int threadCount, qint64 timeLimit, qint64 memoryLimit, BatchWriter *writer, QSemaphore *slots) :
+    format(format),
+    levelNumber(levelNumber),
+    title(title),
+    algorithm(algorithm),
+    threadCount(threadCount),
+    timeLimit(timeLimit),
+    memoryLimit(memoryLimit),
+    writer(writer),
+    slots(slots)
+{
+
+}
+
+BatchTask::~BatchTask()
+{
+    delete format;
+    slots->release();
+}
+
+void BatchTask::run()
+{
+    AbstractSolver *solver = createSolver(algorithm, format, threadCount, memoryLimit);
+    solver->setTimeLimit(timeLimit);
+    solver->setMemoryLimit(memoryLimit);
+    solver->run();
+    SolveStatistics statistics = solver->statistics();
+
+    BatchResult result;
+    result.level = levelNumber;
+    result.title = title;
+    result.algorithm = algorithm;
+    switch (solver->outcome()) {
+    case AbstractSolver::Solved: result.result = "solved"; break;
+    case AbstractSolver::NoSolution: result.result = "unsolvable"; break;
+    case AbstractSolver::Cancelled: result.result = "cancelled"; break;
+    case AbstractSolver::TimedOut: result.result = "timeout"; break;
+    case AbstractSolver::OutOfMemory: result.result = "memory"; break;
+    case AbstractSolver::NotRun: result.result = "not run"; break;
+    }
+    QString moves = solver->getSolutionMoves();
+    result.moves = moves.size();
+    result.pushes = 0;
+    for (QChar move : moves)
+        result.pushes += move.isUpper() ? 1 : 0;
+    result.nodesExpanded = statistics.nodesExpanded;
+    result.corralPrunedPushes = statistics.corralPrunedPushes;
+    result.peakMemory = statistics.memoryBytes;
+    result.elapsedMilliseconds = statistics.elapsedMilliseconds;
+    delete solver;
+    writer->write(result);
+}
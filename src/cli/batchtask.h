@@ -0,0 +1,38 @@
+#ifndef BATCHTASK_H
+#define BATCHTASK_H
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QString>
+
+class BatchWriter;
+class LevelFormat;
+
+/*
+ * Solves one level of a batch on a thread pool thread and writes its
+ * result. The task owns the level format and deletes it when done, then
+ * releases one slot of the semaphore so the reader can queue another
+ * level.
+ */
+
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(LevelFormat *format, int levelNumber, const QString &title, const QString &algorithm,
+              int threadCount, qint64 timeLimit, qint64 memoryLimit, BatchWriter *writer, QSemaphore *slots);
+    ~BatchTask();
+
+    void run() override;
+private:
+    LevelFormat *format;
+    int levelNumber;
+    QString title;
+    QString algorithm;
+    int threadCount;
+    qint64 timeLimit;
+    qint64 memoryLimit;
+    BatchWriter *writer;
+    QSemaphore *slots;
+};
+
+#endif // BATCHTASK_H
@@ -0,0 +1,65 @@
+#include "batchwriter.h"
+
+#include <cstdio>
+#include <QMutexLocker>
+
+BatchWriter::BatchWriter(Format format) :
+    format(format),
+    out(stdout)
+{
+
+}
+
+void BatchWriter::writeHeader()
+{
+    QMutexLocker locker(&mutex);
+    if (format == Csv) {
+        out << "level,title,algorithm,result,pushes,moves,nodes_expanded,corral_pruned_pushes,peak_memory_bytes,time_ms\n";
+        out.flush();
+    }
+}
+
+void BatchWriter::write(const BatchResult &result)
+{
+    QMutexLocker locker(&mutex);
+    if (format == Csv) {
+        out << result.level << ',' << csvField(result.title) << ',' << result.algorithm << ','
+            << result.result << ',' << result.pushes << ',' << result.moves << ','
+            << result.nodesExpanded << ',' << result.corralPrunedPushes << ',' << result.peakMemory << ',' << result.elapsedMilliseconds << '\n';
+    } else {
+        out << "{\"level\":" << result.level
+            << ",\"title\":" << jsonString(result.title)
+            << ",\"algorithm\":" << jsonString(result.algorithm)
+            << ",\"result\":" << jsonString(result.result)
+            << ",\"pushes\":" << result.pushes
+            << ",\"moves\":" << result.moves
+            << ",\"nodesExpanded\":" << result.nodesExpanded
+            << ",\"corralPrunedPushes\":" << result.corralPrunedPushes
+            << ",\"peakMemory\":" << result.peakMemory
+            << ",\"timeMs\":" << result.elapsedMilliseconds << "}\n";
+    }
+    out.flush();
+}
+
+QString BatchWriter::jsonString(const QString &text)
+{
+    QString escaped = "\"";
+    for (QChar c : text) {
+        if (c == '"' || c == '\\')
+            escaped += QString("\\") + c;
+        else if (c.unicode() < 0x20)
+            escaped += QString("\\u%1").arg(int(c.unicode()), 4, 16, QChar('0'));
+        else
+            escaped += c;
+    }
+    return escaped + "\"";
+}
+
+QString BatchWriter::csvField(const QString &text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n'))
+        return text;
+    QString quoted = text;
+    quoted.replace("\"", "\"\"");
+    return "\"" + quoted + "\"";
+}
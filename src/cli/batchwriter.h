@@ -0,0 +1,47 @@
+#ifndef BATCHWRITER_H
+#define BATCHWRITER_H
+
+#include <QMutex>
+#include <QString>
+#include <QTextStream>
+
+struct BatchResult
+{
+    int level; // 1-based position in the collection
+    QString title;
+    QString algorithm;
+    QString result; // solved, unsolvable, cancelled, timeout, memory, not run or invalid
+    int pushes;
+    int moves;
+    qint64 nodesExpanded;
+    qint64 corralPrunedPushes;
+    qint64 peakMemory; // the most bytes the search held at once, see SolveStatistics::memoryBytes
+    qint64 elapsedMilliseconds;
+};
+
+/*
+ * Streams batch results to standard output as JSON lines or CSV. write()
+ * may be called from any thread; each result is written and flushed as a
+ * whole line, so results appear in completion order as soon as they are
+ * known.
+ */
+
+class BatchWriter
+{
+public:
+    enum Format { JsonLines, Csv };
+
+    BatchWriter(Format format);
+
+    void writeHeader();
+    void write(const BatchResult &result);
+private:
+    static QString jsonString(const QString &text);
+    static QString csvField(const QString &text);
+
+    Format format;
+    QMutex mutex;
+    QTextStream out;
+};
+
+#endif // BATCHWRITER_H
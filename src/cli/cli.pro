@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Headless solver: solves one level or a whole
+# collection in XSB/SOK notation and prints the
+# solutions and search statistics.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = sokoban-cli
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../core.pri)
+
+SOURCES += \
+        main.cpp \
+    solverfactory.cpp \
+    batchwriter.cpp \
+    batchtask.cpp
+
+HEADERS += \
+    solverfactory.h \
+    batchwriter.h \
+    batchtask.h
@@ -0,0 +1,190 @@
+#include "abstractsolver.h"
+#include "batchtask.h"
+#include "batchwriter.h"
+#include "levelcollection.h"
+#include "solverfactory.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSemaphore>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+/*
+ * Solves every level of the collection on a thread pool, streaming one
+ * result per level. At most twice as many levels as there are threads
+ * are parsed ahead, so memory stays bounded for any collection size.
+ */
+static int solveBatch(LevelCollection &collection, const QString &algorithm, int jobs, int threadCount,
+                      qint64 timeLimit, qint64 memoryLimit, BatchWriter::Format format)
+{
+    BatchWriter writer(format);
+    writer.writeHeader();
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+    QSemaphore slots(2 * jobs);
+    while (collection.hasNext()) {
+        slots.acquire();
+        QString error;
+        LevelFormat *level = collection.next(&error);
+        if (!level) {
+            BatchResult result;
+            result.level = collection.levelNumber();
+            result.title = collection.title();
+            result.algorithm = algorithm;
+            result.result = "invalid";
+            result.pushes = 0;
+            result.moves = 0;
+            result.nodesExpanded = 0;
+            result.corralPrunedPushes = 0;
+            result.peakMemory = 0;
+            result.elapsedMilliseconds = 0;
+            writer.write(result);
+            slots.release();
+            continue;
+        }
+        pool.start(new BatchTask(level, collection.levelNumber(), collection.title(), algorithm,
+                                 threadCount, timeLimit, memoryLimit, &writer, &slots));
+    }
+    pool.waitForDone();
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sokoban-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Solves Sokoban levels from a collection in XSB/SOK notation.");
+    parser.addHelpOption();
+    QCommandLineOption algorithmOption(QStringList() << "a" << "algorithm",
+                                       "Search algorithm: " + solverNames().join(", ") + ". Defaults to astar.",
+                                       "name", solverNames().first());
+    parser.addOption(algorithmOption);
+    QCommandLineOption levelOption(QStringList() << "l" << "level",
+                                   "Number of the level to solve in the collection (default 1).",
+                                   "number", "1");
+    parser.addOption(levelOption);
+    QCommandLineOption batchOption(QStringList() << "b" << "batch",
+                                   "Solve every level in the collection in parallel.");
+    parser.addOption(batchOption);
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "Number of levels solved at once in batch mode (default: one per core).",
+                                  "count", QString::number(QThread::idealThreadCount()));
+    parser.addOption(jobsOption);
+    QCommandLineOption threadsOption(QStringList() << "threads",
+                                     "Worker threads per level for hdastar (default: one per core, or one per job in batch mode).",
+                                     "count", "0");
+    parser.addOption(threadsOption);
+    QCommandLineOption timeLimitOption(QStringList() << "t" << "time-limit",
+                                       "Give up on a level after this many seconds (default: no limit).",
+                                       "seconds", "0");
+    parser.addOption(timeLimitOption);
+    QCommandLineOption memoryLimitOption(QStringList() << "m" << "memory-limit",
+                                         "Give up on a level once its search nodes, tables and open lists take this many MiB (default: no limit). idastar sizes its transposition table to fit in it (default 64, at most 1024), and external keeps up to half of it of its open list in memory before the rest goes to disk (default 256).",
+                                         "mib", "0");
+    parser.addOption(memoryLimitOption);
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                    "Batch output format: json (one object per line, the default) or csv.",
+                                    "format", "json");
+    parser.addOption(formatOption);
+    QCommandLineOption phasesOption(QStringList() << "phase-counters",
+                                    "Time the phases of the search (move generation, heuristic, deadlock detection, duplicate checks, allocation) and print how long each took. Only for a single level.");
+    parser.addOption(phasesOption);
+    parser.addPositionalArgument("file", "Level file, or - for standard input (the default).");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QString algorithm = parser.value(algorithmOption);
+    if (!solverNames().contains(algorithm)) {
+        err << "Unknown algorithm " << algorithm << "\n";
+        return 2;
+    }
+    int threadCount = qMax(0, parser.value(threadsOption).toInt());
+    qint64 timeLimit = qint64(parser.value(timeLimitOption).toDouble() * 1000);
+    qint64 memoryLimit = qint64(parser.value(memoryLimitOption).toDouble() * 1024 * 1024);
+    PhaseTimer::setEnabled(parser.isSet(phasesOption));
+    LevelCollection collection;
+    QString path = parser.positionalArguments().value(0, "-");
+    if (!collection.open(path)) {
+        err << "Cannot open " << path << ": " << collection.errorString() << "\n";
+        return 2;
+    }
+
+    if (parser.isSet(batchOption)) {
+        int jobs = qMax(1, parser.value(jobsOption).toInt());
+        QString format = parser.value(formatOption);
+        if (format != "json" && format != "csv") {
+            err << "Unknown format " << format << "\n";
+            return 2;
+        }
+        // parallel solvers share the cores with the other jobs
+        if (threadCount == 0)
+            threadCount = qMax(1, QThread::idealThreadCount() / jobs);
+        return solveBatch(collection, algorithm, jobs, threadCount, timeLimit, memoryLimit,
+                          format == "csv" ? BatchWriter::Csv : BatchWriter::JsonLines);
+    }
+
+    int levelNumber = parser.value(levelOption).toInt();
+    while (collection.levelNumber() + 1 < levelNumber && collection.skip()) {}
+    if (levelNumber < 1 || !collection.hasNext()) {
+        err << "No level " << parser.value(levelOption) << " in " << path << "\n";
+        return 2;
+    }
+
+    QString error;
+    LevelFormat *format = collection.next(&error);
+    if (!format) {
+        err << "Invalid level " << levelNumber << ": " << error << "\n";
+        return 2;
+    }
+    AbstractSolver *solver = createSolver(algorithm, format, threadCount, memoryLimit);
+    solver->setTimeLimit(timeLimit);
+    solver->setMemoryLimit(memoryLimit);
+    solver->setSolutionCallback([&out](const SolutionReport &report) {
+        out << "Found: " << report.cost << " moves, optimum at least " << report.lowerBound
+            << " (" << report.elapsedMilliseconds << " ms)\n";
+        out.flush();
+    });
+
+    bool solved = solver->run();
+    SolveStatistics statistics = solver->statistics();
+    if (!collection.title().isEmpty())
+        out << "Level: " << collection.title() << "\n";
+    switch (solver->outcome()) {
+    case AbstractSolver::Solved: out << "Result: solved\n"; break;
+    case AbstractSolver::TimedOut: out << "Result: time limit reached\n"; break;
+    case AbstractSolver::OutOfMemory: out << "Result: memory limit reached\n"; break;
+    default: out << "Result: no solution\n"; break;
+    }
+    if (solved) {
+        QString moves = solver->getSolutionMoves();
+        int pushes = 0;
+        for (QChar move : moves)
+            pushes += move.isUpper() ? 1 : 0;
+        out << "Moves: " << moves.size() << "\n";
+        out << "Pushes: " << pushes << "\n";
+        out << "Solution: " << moves << "\n";
+    }
+    out << "Nodes expanded: " << statistics.nodesExpanded << "\n";
+    out << "Nodes generated: " << statistics.nodesGenerated << "\n";
+    out << "Time: " << statistics.elapsedMilliseconds << " ms" << "\n";
+    out << "Peak memory: " << statistics.memoryBytes / 1024 << " KiB" << "\n";
+    out << "Corral pruned pushes: " << statistics.corralPrunedPushes << "\n";
+    if (statistics.phases.any()) {
+        for (int phase = 0; phase < PhaseTotals::PhaseCount; ++phase) {
+            qint64 calls = statistics.phases.calls[phase];
+            qint64 nanoseconds = statistics.phases.nanoseconds[phase];
+            out << "Phase " << PhaseTotals::name(phase) << ": " << calls << " calls, " << nanoseconds / 1000000
+                << " ms, " << (calls ? nanoseconds / calls : 0) << " ns per call\n";
+        }
+    }
+
+    delete solver;
+    delete format;
+    return solved ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "solverfactory.h"
+#include "anytimeastarsolver.h"
+#include "astarsolver.h"
+#include "bfssolver.h"
+#include "bidirectionalsolver.h"
+#include "dfssolver.h"
+#include "externalastarsolver.h"
+#include "hdastarsolver.h"
+#include "idastarsolver.h"
+#include "lcfssolver.h"
+
+QStringList solverNames()
+{
+    return QStringList() << "astar" << "anytime" << "hdastar" << "idastar" << "external" << "bidir" << "lcfs" << "bfs" << "dfs";
+}
+
+AbstractSolver *createSolver(const QString &name, LevelFormat *format, int threadCount, qint64 memoryLimit)
+{
+    if (name == "astar")
+        return new AStarSolver(format);
+    else if (name == "anytime")
+        return new AnytimeAStarSolver(format);
+    else if (name == "hdastar")
+        return new HDAStarSolver(format, threadCount);
+    else if (name == "idastar")
+        return new IDAStarSolver(format, memoryLimit);
+    else if (name == "external")
+        return new ExternalAStarSolver(format, memoryLimit / 2); // the rest is for the arena and merging
+    else if (name == "bidir")
+        return new BidirectionalSolver(format);
+    else if (name == "lcfs")
+        return new LCFSSolver(format);
+    else if (name == "bfs")
+        return new BFSSolver(format);
+    else if (name == "dfs")
+        return new DFSSolver(format);
+    return nullptr;
+}
@@ -0,0 +1,18 @@
+#ifndef SOLVERFACTORY_H
+#define SOLVERFACTORY_H
+
+#include <QString>
+#include <QStringList>
+
+class AbstractSolver;
+class LevelFormat;
+
+// names accepted by createSolver, the first is the default
+QStringList solverNames();
+// nullptr if the name is unknown, threadCount only applies to parallel
+// solvers (0 uses one thread per core), and memoryLimit to the ones with
+// a fixed-size table or an in-memory budget, which are sized to fit it
+// (0 for their default)
+AbstractSolver *createSolver(const QString &name, LevelFormat *format, int threadCount = 0, qint64 memoryLimit = 0);
+
+#endif // SOLVERFACTORY_H
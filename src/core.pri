@@ -0,0 +1,50 @@
+# Level representation and solvers, shared by the GUI and the headless
+# tools. Only depends on QtCore.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# CONFIG += no_phase_counters compiles the per-phase timers out, see
+# phasecounters.h
+no_phase_counters: DEFINES += NO_PHASE_COUNTERS
+
+SOURCES += \
+    $$PWD/levelformat.cpp \
+    $$PWD/abstractsolver.cpp \
+    $$PWD/dfssolver.cpp \
+    $$PWD/bfssolver.cpp \
+    $$PWD/lcfssolver.cpp \
+    $$PWD/astarsolver.cpp \
+    $$PWD/anytimeastarsolver.cpp \
+    $$PWD/hdastarsolver.cpp \
+    $$PWD/idastarsolver.cpp \
+    $$PWD/externalastarsolver.cpp \
+    $$PWD/bidirectionalsolver.cpp \
+    $$PWD/transpositiontable.cpp \
+    $$PWD/bucketqueue.cpp \
+    $$PWD/nodearena.cpp \
+    $$PWD/phasecounters.cpp \
+    $$PWD/levelcollection.cpp \
+    $$PWD/deadlockpatterns.cpp \
+    $$PWD/boxmatching.cpp
+
+HEADERS += \
+    $$PWD/levelformat.h \
+    $$PWD/abstractsolver.h \
+    $$PWD/dfssolver.h \
+    $$PWD/bfssolver.h \
+    $$PWD/lcfssolver.h \
+    $$PWD/astarsolver.h \
+    $$PWD/anytimeastarsolver.h \
+    $$PWD/hdastarsolver.h \
+    $$PWD/idastarsolver.h \
+    $$PWD/externalastarsolver.h \
+    $$PWD/bidirectionalsolver.h \
+    $$PWD/transpositiontable.h \
+    $$PWD/bucketqueue.h \
+    $$PWD/bitboard.h \
+    $$PWD/nodearena.h \
+    $$PWD/phasecounters.h \
+    $$PWD/levelcollection.h \
+    $$PWD/deadlockpatterns.h \
+    $$PWD/boxmatching.h
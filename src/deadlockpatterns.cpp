@@ -0,0 +1,60 @@
+#include "deadlockpatterns.h"
+
+#include <QReadLocker>
+#include <QWriteLocker>
+
+DeadlockPatterns::DeadlockPatterns(int cells) :
+    precomputed(cells),
+    learned(cells),
+    precomputedPatterns(0),
+    learnedPatterns(0)
+{
+
+}
+
+void DeadlockPatterns::addPrecomputed(const Bitboard &pattern)
+{
+    precomputed[pattern.first()].append(pattern);
+    ++precomputedPatterns;
+}
+
+void DeadlockPatterns::learn(const Bitboard &pattern)
+{
+    QWriteLocker locker(&learnedLock);
+    // another thread may have found the same deadlock in the meantime
+    if (matchesAny(learned, pattern))
+        return;
+    learned[pattern.first()].append(pattern);
+    learnedPatterns.ref();
+}
+
+bool DeadlockPatterns::matches(const Bitboard &movables) const
+{
+    if (matchesAny(precomputed, movables))
+        return true;
+    if (learnedPatterns.loadAcquire() == 0)
+        return false;
+    QReadLocker locker(&learnedLock);
+    return matchesAny(learned, movables);
+}
+
+int DeadlockPatterns::precomputedCount() const
+{
+    return precomputedPatterns;
+}
+
+int DeadlockPatterns::learnedCount() const
+{
+    return learnedPatterns.loadAcquire();
+}
+
+bool DeadlockPatterns::matchesAny(const QVector<QVector<Bitboard>> &patterns, const Bitboard &movables)
+{
+    for (int movable = movables.first(); movable != -1; movable = movables.next(movable)) {
+        for (const Bitboard &pattern : patterns.at(movable)) {
+            if (movables.contains(pattern))
+                return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,43 @@
+#ifndef DEADLOCKPATTERNS_H
+#define DEADLOCKPATTERNS_H
+
+#include "bitboard.h"
+
+#include <QAtomicInt>
+#include <QReadWriteLock>
+#include <QVector>
+
+/*
+ * Sets of box positions known to make a level unsolvable no matter where
+ * the other boxes are. Since extra boxes can only get in the way, a state
+ * is dead as soon as its boxes cover any stored pattern. Patterns are
+ * filed under their lowest cell, so a lookup only tries the patterns
+ * anchored at one of the state's boxes.
+ *
+ * Precomputed patterns are added while the level is built and never
+ * change afterwards, so they are read without locking. Learned patterns
+ * may be added by several solver threads at once and sit behind a lock.
+ */
+
+class DeadlockPatterns
+{
+public:
+    DeadlockPatterns(int cells);
+
+    void addPrecomputed(const Bitboard &pattern); // not thread-safe, only while building the level
+    void learn(const Bitboard &pattern);
+    bool matches(const Bitboard &movables) const;
+
+    int precomputedCount() const;
+    int learnedCount() const;
+private:
+    static bool matchesAny(const QVector<QVector<Bitboard>> &patterns, const Bitboard &movables);
+
+    QVector<QVector<Bitboard>> precomputed; // by lowest cell
+    QVector<QVector<Bitboard>> learned; // by lowest cell, guarded by learnedLock
+    int precomputedPatterns;
+    QAtomicInt learnedPatterns;
+    mutable QReadWriteLock learnedLock;
+};
+
+#endif // DEADLOCKPATTERNS_H
@@ -1,57 +1,35 @@
 #include "dfssolver.h"
 #include "levelformat.h"
+#include "transpositiontable.h"
 
 #include <QStack>
 
 DFSSolver::DFSSolver(LevelFormat *format):
     AbstractSolver (format)
 {
-    solved = solve();
+
 }
 
 bool DFSSolver::solve()
 {
-    QSet<LevelState *> seen;
-    QStack<LevelState*> frontier;
-    frontier.push(level->getInitialState());
+    TranspositionTable table(level);
+    QStack<quint32> frontier;
+    setMemoryProbe([&] { return table.bytesUsed() + qint64(frontier.capacity()) * qint64(sizeof(quint32)); });
+    QVector<LevelState> nextStates;
+    frontier.push(nodes.allocate(*level->getInitialState(), NodeArena::NoNode));
     while (!frontier.isEmpty()) {
-        LevelState *state = frontier.pop();
+        quint32 index = frontier.pop();
+        LevelState *state = nodes.at(index);
+        if (!keepSearching(frontier.size()))
+            return false;
         if (level->goalReached(state)) {
-            while (state->previousState) {
-                solution.prepend(state);
-                seen.remove(state);
-                state = state->previousState;
-            }
-            solution.prepend(level->getInitialState());
-            seen.remove(level->getInitialState());
-            for (LevelState *seenState : seen)
-                delete seenState;
-            for (LevelState *queuedState : frontier)
-                delete queuedState;
-            solved = true;
+            buildSolution(index);
             return true;
-        } else {
-            bool isNewState = true;
-            for (LevelState *seenState : seen) {
-                if (level->similarTo(state, seenState)) {
-                    isNewState = false;
-                    break;
-                }
-            }
-            seen.insert(state);
-            if (isNewState) {
-                QSet<LevelState*> *nextStates = level->nextStatesFor(state);
-                if (nextStates) {
-                    for (LevelState *nextState : *nextStates) {
-                        frontier.push(nextState);
-                    }
-                }
-            }
+        } else if (table.insert(state)) {
+            generateNextStates(state, nextStates);
+            for (const LevelState &nextState : nextStates)
+                frontier.push(nodes.allocate(nextState, index));
         }
     }
-    for (LevelState *seenState : seen)
-        delete seenState;
-    for (LevelState *queuedState : frontier)
-        delete queuedState;
     return false;
 }
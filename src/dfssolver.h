@@ -7,6 +7,7 @@ class DFSSolver : public AbstractSolver
 {
 public:
     DFSSolver(LevelFormat *format);
+protected:
     bool solve() override;
 };
 
@@ -0,0 +1,363 @@
+#include "externalastarsolver.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtDebug>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// the closed runs are merged into one once there are more than this, as
+// every expansion advances a cursor in each of them
+const int MaxClosedRuns = 16;
+
+}
+
+const qint64 ExternalAStarSolver::DefaultMemoryBudget;
+
+ExternalAStarSolver::ExternalAStarSolver(LevelFormat *format, qint64 memoryBudget, const QString &directory) :
+    AbstractSolver (format),
+    memoryBudget(memoryBudget > 0 ? memoryBudget : DefaultMemoryBudget),
+    directory(directory.isEmpty() ? QDir::tempPath() : directory),
+    runDirectory(nullptr),
+    runsCreated(0),
+    bufferedRecords(0),
+    spilledRecords(0),
+    diskFailed(false)
+{
+
+}
+
+ExternalAStarSolver::~ExternalAStarSolver()
+{
+    removeAllRuns();
+}
+
+bool ExternalAStarSolver::solve()
+{
+    removeAllRuns();
+    // the runs are mapped from disk and left out
+    setMemoryProbe([this] { return bufferedRecords * qint64(sizeof(Record)); });
+    runDirectory = new QTemporaryDir(directory + "/sokoban-XXXXXX");
+    if (!runDirectory->isValid()) {
+        qWarning() << "Cannot create a directory for run files in" << directory;
+        return false;
+    }
+    LevelState *initialState = level->getInitialState();
+    int heuristic = level->getHeuristic(initialState);
+    if (heuristic == -1)
+        return false;
+    add(recordFor(*initialState, nullptr), heuristic);
+    bool goalFound = false;
+    while (!buckets.isEmpty() && !diskFailed) {
+        BucketKey key = buckets.firstKey();
+        Bucket bucket = buckets.take(key);
+        bool searching = expandBucket(key, bucket, &goalFound);
+        bufferedRecords -= qint64(bucket.records.size());
+        for (Run &run : bucket.runs) {
+            spilledRecords -= run.count;
+            removeRun(run);
+        }
+        if (!searching)
+            break;
+    }
+    if (diskFailed)
+        qWarning() << "Cannot write run files in" << runDirectory->path();
+    return goalFound && !diskFailed;
+}
+
+void ExternalAStarSolver::removeAllRuns()
+{
+    for (Bucket &bucket : buckets) {
+        for (Run &run : bucket.runs)
+            removeRun(run);
+    }
+    buckets.clear();
+    for (Run &run : closedRuns)
+        removeRun(run);
+    closedRuns.clear();
+    delete runDirectory;
+    runDirectory = nullptr;
+    runsCreated = 0;
+    bufferedRecords = 0;
+    spilledRecords = 0;
+    diskFailed = false;
+}
+
+/*
+ * Merges the bucket's records and runs into one sorted stream and expands
+ * every state in it that is neither a repeat nor in the closed set. Those
+ * are appended, still sorted, to a new closed run.
+ */
+bool ExternalAStarSolver::expandBucket(const BucketKey &key, Bucket &bucket, bool *goalFound)
+{
+    struct Cursor
+    {
+        const Record *at;
+        const Record *end;
+    };
+    std::sort(bucket.records.begin(), bucket.records.end(), keyLess);
+    std::vector<Cursor> sources;
+    sources.push_back({ bucket.records.data(), bucket.records.data() + bucket.records.size() });
+    for (const Run &run : bucket.runs)
+        sources.push_back({ run.records, run.records + run.count });
+    std::vector<Cursor> closed;
+    for (const Run &run : closedRuns)
+        closed.push_back({ run.records, run.records + run.count });
+
+    Run expanded = startRun();
+    const Record *previous = nullptr;
+    bool stopped = false;
+    while (!stopped && !diskFailed) {
+        int smallest = -1;
+        for (int i = 0; i < int(sources.size()); ++i) {
+            if (sources[i].at != sources[i].end
+                    && (smallest == -1 || keyLess(*sources[i].at, *sources[smallest].at)))
+                smallest = i;
+        }
+        if (smallest == -1)
+            break;
+        const Record *record = sources[smallest].at++;
+        if (previous && sameKey(*previous, *record))
+            continue;
+        previous = record;
+        // the stream and the closed runs are in the same order, so each
+        // closed run is only scanned once per bucket
+        bool duplicate = false;
+        for (Cursor &run : closed) {
+            while (run.at != run.end && keyLess(*run.at, *record))
+                ++run.at;
+            duplicate = duplicate || (run.at != run.end && sameKey(*run.at, *record));
+        }
+        if (duplicate)
+            continue;
+        if (!keepSearching(int(qMin(bufferedRecords + spilledRecords, qint64(INT_MAX))), key.first)) {
+            stopped = true;
+            break;
+        }
+        LevelState state = stateFor(*record);
+        if (level->goalReached(&state)) {
+            *goalFound = buildSolutionFrom(*record);
+            stopped = true;
+            break;
+        }
+        append(expanded, record, 1);
+        generateNextStates(&state, nextStates);
+        for (LevelState &nextState : nextStates) {
+            int heuristic = level->getHeuristic(&nextState);
+            if (heuristic != -1)
+                add(recordFor(nextState, record), heuristic);
+        }
+    }
+    if (stopped || diskFailed || !finishRun(expanded) || expanded.count == 0) {
+        removeRun(expanded);
+        return !stopped && !diskFailed;
+    }
+    closedRuns.append(expanded);
+    return closedRuns.size() <= MaxClosedRuns || mergeClosedRuns();
+}
+
+/*
+ * Records go into the bucket of their f-value and cost. Once the buckets
+ * take up the whole memory budget, the largest one goes to disk.
+ */
+void ExternalAStarSolver::add(const Record &record, int heuristic)
+{
+    buckets[BucketKey(record.cost + heuristic, record.cost)].records.push_back(record);
+    ++bufferedRecords;
+    if (bufferedRecords * qint64(sizeof(Record)) > memoryBudget && !spillLargestBucket())
+        diskFailed = true;
+}
+
+bool ExternalAStarSolver::spillLargestBucket()
+{
+    Bucket *largest = nullptr;
+    for (Bucket &bucket : buckets) {
+        if (!largest || bucket.records.size() > largest->records.size())
+            largest = &bucket;
+    }
+    if (!largest || largest->records.empty())
+        return true;
+    std::vector<Record> &records = largest->records;
+    std::sort(records.begin(), records.end(), keyLess);
+    records.erase(std::unique(records.begin(), records.end(), sameKey), records.end());
+    Run run = startRun();
+    if (!append(run, records.data(), qint64(records.size())) || !finishRun(run)) {
+        removeRun(run);
+        return false;
+    }
+    largest->runs.append(run);
+    bufferedRecords -= qint64(records.size());
+    spilledRecords += run.count;
+    // clear() would keep the capacity
+    std::vector<Record>().swap(records);
+    return true;
+}
+
+ExternalAStarSolver::Run ExternalAStarSolver::startRun()
+{
+    Run run = { new QFile(runDirectory->filePath(QString("run%1").arg(runsCreated++))), nullptr, 0 };
+    if (!run.file->open(QIODevice::WriteOnly))
+        diskFailed = true;
+    return run;
+}
+
+bool ExternalAStarSolver::append(Run &run, const Record *records, qint64 count)
+{
+    qint64 bytes = count * qint64(sizeof(Record));
+    if (!run.file->isOpen() || run.file->write(reinterpret_cast<const char *>(records), bytes) != bytes) {
+        diskFailed = true;
+        return false;
+    }
+    run.count += count;
+    return true;
+}
+
+bool ExternalAStarSolver::finishRun(Run &run)
+{
+    run.file->close();
+    if (run.count == 0)
+        return true;
+    if (!run.file->open(QIODevice::ReadOnly)) {
+        diskFailed = true;
+        return false;
+    }
+    run.records = reinterpret_cast<const Record *>(run.file->map(0, run.count * qint64(sizeof(Record))));
+    if (!run.records) {
+        diskFailed = true;
+        return false;
+    }
+    return true;
+}
+
+void ExternalAStarSolver::removeRun(Run &run)
+{
+    if (run.records)
+        run.file->unmap(reinterpret_cast<uchar *>(const_cast<Record *>(run.records)));
+    run.file->close();
+    run.file->remove();
+    delete run.file;
+    run.file = nullptr;
+    run.records = nullptr;
+    run.count = 0;
+}
+
+/*
+ * The closed runs never share a state, so merging them is a plain k-way
+ * merge into a new run.
+ */
+bool ExternalAStarSolver::mergeClosedRuns()
+{
+    std::vector<qint64> positions(closedRuns.size(), 0);
+    Run merged = startRun();
+    while (!diskFailed) {
+        int smallest = -1;
+        for (int i = 0; i < closedRuns.size(); ++i) {
+            const Run &run = closedRuns.at(i);
+            if (positions[i] != run.count
+                    && (smallest == -1 || keyLess(run.records[positions[i]],
+                                                  closedRuns.at(smallest).records[positions[smallest]])))
+                smallest = i;
+        }
+        if (smallest == -1)
+            break;
+        append(merged, closedRuns.at(smallest).records + positions[smallest]++, 1);
+    }
+    if (diskFailed || !finishRun(merged)) {
+        removeRun(merged);
+        return false;
+    }
+    for (Run &run : closedRuns)
+        removeRun(run);
+    closedRuns.clear();
+    closedRuns.append(merged);
+    return true;
+}
+
+const ExternalAStarSolver::Record *ExternalAStarSolver::findClosed(const Record &record) const
+{
+    for (const Run &run : closedRuns) {
+        const Record *found = std::lower_bound(run.records, run.records + run.count, record, keyLess);
+        if (found != run.records + run.count && sameKey(*found, record))
+            return found;
+    }
+    return nullptr;
+}
+
+/*
+ * Undoes the push each record was reached by to find its parent, which
+ * was expanded in an earlier bucket and so is in the closed set.
+ */
+bool ExternalAStarSolver::buildSolutionFrom(const Record &goal)
+{
+    QList<Record> path;
+    path.prepend(goal);
+    while (path.first().parentPlayer != -1) {
+        Record parent = path.first();
+        parent.movables.reset(parent.movedTo);
+        parent.movables.set(parent.movedFrom);
+        parent.player = parent.parentPlayer;
+        const Record *found = findClosed(parent);
+        if (!found) {
+            qWarning() << "The closed set lost a state on the solution path";
+            return false;
+        }
+        path.prepend(*found);
+    }
+    quint32 index = NodeArena::NoNode;
+    for (const Record &record : path)
+        index = nodes.allocate(stateFor(record), index);
+    buildSolution(index);
+    return true;
+}
+
+bool ExternalAStarSolver::keyLess(const Record &a, const Record &b)
+{
+    for (int i = 0; i < Bitboard::Words; ++i) {
+        if (a.movables.word(i) != b.movables.word(i))
+            return a.movables.word(i) < b.movables.word(i);
+    }
+    return a.player < b.player;
+}
+
+bool ExternalAStarSolver::sameKey(const Record &a, const Record &b)
+{
+    return a.player == b.player && a.movables == b.movables;
+}
+
+ExternalAStarSolver::Record ExternalAStarSolver::recordFor(const LevelState &state, const Record *parent)
+{
+    Record record;
+    record.movables = state.movables;
+    record.movablesKey = state.movablesKey;
+    record.cost = state.cost;
+    record.player = qint16(state.player);
+    record.parentPlayer = -1;
+    record.movedFrom = -1;
+    record.movedTo = -1;
+    record.reserved = 0;
+    if (parent) {
+        record.parentPlayer = parent->player;
+        record.movedFrom = qint16((parent->movables & ~state.movables).first());
+        record.movedTo = qint16((state.movables & ~parent->movables).first());
+    }
+    return record;
+}
+
+LevelState ExternalAStarSolver::stateFor(const Record &record)
+{
+    LevelState state;
+    state.movables = record.movables;
+    state.player = record.player;
+    state.previousState = NodeArena::NoNode;
+    state.cost = record.cost;
+    state.movablesKey = record.movablesKey;
+    return state;
+}
+
+bool ExternalAStarSolver::findsOptimalSolutions() const
+{
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef EXTERNALASTARSOLVER_H
+#define EXTERNALASTARSOLVER_H
+
+#include "abstractsolver.h"
+#include "levelformat.h"
+
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <vector>
+
+class QFile;
+class QTemporaryDir;
+
+/*
+ * A* for searches that do not fit in memory. The open list is split into
+ * buckets by f-value and cost, which are expanded in order: a child costs
+ * more than its parent, so it always goes into a later bucket. Each bucket
+ * is kept in memory until all buckets together outgrow the memory budget,
+ * at which point the largest one is sorted and written to a run file.
+ *
+ * Duplicates are not looked up when states are generated, but when their
+ * bucket is expanded: its runs are merged in sorted order, and the states
+ * expanded before are taken out with a single pass over the closed set,
+ * which is itself a list of sorted runs, one per bucket (merged into one
+ * whenever there are too many). Run files are memory-mapped for reading,
+ * so only the pages being scanned need to be resident.
+ *
+ * Every record holds the push that led to it, which is enough to look up
+ * its parent in the closed set, so the solution is rebuilt from disk once
+ * a goal is expanded. Like IDAStarSolver, states are told apart by their
+ * exact player position, so the first time a state is expanded is also
+ * the cheapest, and solutions cost the same as AStarSolver's.
+ */
+
+class ExternalAStarSolver : public AbstractSolver
+{
+public:
+    static const qint64 DefaultMemoryBudget = 256 * 1024 * 1024;
+
+    // run files go in a temporary directory inside directory, by default
+    // the system's
+    ExternalAStarSolver(LevelFormat *format, qint64 memoryBudget = DefaultMemoryBudget,
+                        const QString &directory = QString());
+    ~ExternalAStarSolver();
+protected:
+    bool solve() override;
+    bool findsOptimalSolutions() const override;
+private:
+    struct Record
+    {
+        Bitboard movables;
+        quint64 movablesKey;
+        qint32 cost;
+        qint16 player;
+        qint16 parentPlayer; // -1 for the initial state
+        qint16 movedFrom; // cell the pushed box left, -1 for the initial state
+        qint16 movedTo;
+        quint32 reserved; // zero, so records have no uninitialised padding
+    };
+    struct Run
+    {
+        QFile *file;
+        const Record *records; // mapped, nullptr if empty
+        qint64 count;
+    };
+    struct Bucket
+    {
+        std::vector<Record> records;
+        QList<Run> runs;
+    };
+    typedef QPair<int, int> BucketKey; // f-value, then cost
+
+    // returns false if the search should stop, which it also should once
+    // the goal was found
+    bool expandBucket(const BucketKey &key, Bucket &bucket, bool *goalFound);
+    void add(const Record &record, int heuristic);
+    bool spillLargestBucket();
+    Run startRun();
+    bool append(Run &run, const Record *records, qint64 count);
+    bool finishRun(Run &run); // maps what was appended
+    void removeRun(Run &run);
+    void removeAllRuns(); // and the directory they are in, undoing an earlier solve
+    bool mergeClosedRuns();
+    const Record *findClosed(const Record &record) const;
+    bool buildSolutionFrom(const Record &goal);
+    static bool keyLess(const Record &a, const Record &b);
+    static bool sameKey(const Record &a, const Record &b);
+    static Record recordFor(const LevelState &state, const Record *parent);
+    static LevelState stateFor(const Record &record);
+
+    qint64 memoryBudget;
+    QString directory;
+    QTemporaryDir *runDirectory;
+    int runsCreated;
+    QMap<BucketKey, Bucket> buckets;
+    qint64 bufferedRecords; // in memory, over every bucket
+    qint64 spilledRecords;
+    bool diskFailed; // a run could not be written or mapped
+    QList<Run> closedRuns;
+    QVector<LevelState> nextStates;
+};
+
+#endif // EXTERNALASTARSOLVER_H
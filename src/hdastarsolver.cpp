@@ -0,0 +1,345 @@
+#include "hdastarsolver.h"
+#include "levelformat.h"
+#include "transpositiontable.h"
+
+#include <climits>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSemaphore>
+#include <QThread>
+
+namespace {
+
+// children bound for another worker are sent once this many have piled up,
+// or when the sender runs out of work
+const int BatchSize = 64;
+// how often workers publish their counters and flush partial batches
+const int PublishInterval = 256;
+
+// (f-value, local node index), lowest f first
+typedef QPair<int, quint32> Entry;
+
+struct EntryOrder
+{
+    bool operator()(const Entry &a, const Entry &b) const { return a.first > b.first; }
+};
+
+}
+
+struct HDAStarSolver::Worker
+{
+    Worker(const LevelFormat *format, int threadCount) :
+        table(format),
+        outgoing(threadCount),
+        inbox(nullptr),
+        parked(0),
+        expanded(0),
+        generated(0),
+        bytes(0),
+        corralPrunedPushes(0),
+        frontierSize(0),
+        bestFValue(-1),
+        phases(),
+        active(false)
+    {
+    }
+
+    qint64 bytesUsed() const
+    {
+        return nodes.bytesAllocated() + table.bytesUsed() + qint64(frontier.size()) * qint64(sizeof(Entry));
+    }
+
+    NodeArena nodes;
+    TranspositionTable table;
+    std::priority_queue<Entry, std::vector<Entry>, EntryOrder> frontier;
+    QVector<QVector<Message>> outgoing; // per destination worker
+    QAtomicPointer<MessageBatch> inbox; // lock-free stack, pushed by any worker, emptied by the owner
+    QSemaphore wakeup; // waited on while idle
+    QAtomicInt parked; // 1 while the worker may be waiting, cleared by the sender that wakes it
+
+    // published every PublishInterval expansions for the thread polling progress
+    QAtomicInteger<qint64> expanded;
+    QAtomicInteger<qint64> generated;
+    QAtomicInteger<qint64> bytes;
+    QAtomicInteger<qint64> corralPrunedPushes;
+    QAtomicInt frontierSize;
+    QAtomicInt bestFValue;
+    PhaseTotals phases; // only written once the worker is done
+
+    bool active; // counted in outstanding, only touched by the worker itself
+};
+
+HDAStarSolver::HDAStarSolver(LevelFormat *format, int threadCount) :
+    AbstractSolver (format),
+    threadCount(threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount())),
+    outstanding(0),
+    finished(0),
+    stopRequested(0),
+    bestCost(INT_MAX),
+    bestGoal(NodeArena::NoNode)
+{
+
+}
+
+HDAStarSolver::~HDAStarSolver()
+{
+    clearWorkers();
+}
+
+bool HDAStarSolver::solve()
+{
+    clearWorkers();
+    for (int i = 0; i < threadCount; ++i)
+        workers.append(new Worker(level, threadCount));
+    outstanding.storeRelease(1);
+    finished.storeRelease(0);
+    stopRequested.storeRelease(0);
+    bestCost.storeRelease(INT_MAX);
+    bestGoal = NodeArena::NoNode;
+
+    LevelState *initialState = level->getInitialState();
+    int initialHeuristic = level->getHeuristic(initialState);
+    if (initialHeuristic == -1)
+        return false;
+    Worker *owner = workers.at(ownerOf(*initialState));
+    owner->active = true;
+    LevelState root = *initialState;
+    root.previousState = NodeArena::NoNode;
+    push(owner, root, initialHeuristic);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i)
+        threads.emplace_back(&HDAStarSolver::work, this, i);
+    while (!finished.loadAcquire() && !stopRequested.loadAcquire()) {
+        QThread::msleep(1);
+        int frontierSize = 0, bestFValue = -1;
+        for (Worker *worker : workers) {
+            frontierSize += worker->frontierSize.loadAcquire();
+            int fValue = worker->bestFValue.loadAcquire();
+            if (fValue != -1 && (bestFValue == -1 || fValue < bestFValue))
+                bestFValue = fValue;
+        }
+        recordWorkerTotals(gatherTotals());
+        if (!keepSearchingInParallel(frontierSize, bestFValue)) {
+            stopRequested.storeRelease(1);
+            wakeAll();
+        }
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    SolveStatistics totals = gatherTotals();
+    for (Worker *worker : workers)
+        totals.phases += worker->phases;
+    recordWorkerTotals(totals);
+    // besides cancellation and the limits, workers also stop the search if
+    // they run out of node ids
+    if (stopRequested.loadAcquire() || bestGoal == NodeArena::NoNode) {
+        clearWorkers();
+        return false;
+    }
+
+    // copy the solution path into the solver's own arena so that the
+    // worker arenas can be released
+    QVector<LevelState> path;
+    for (quint32 id = bestGoal; id != NodeArena::NoNode; id = nodeAt(id)->previousState)
+        path.prepend(*nodeAt(id));
+    quint32 index = NodeArena::NoNode;
+    for (const LevelState &state : path)
+        index = nodes.allocate(state, index);
+    clearWorkers();
+    buildSolution(index);
+    return true;
+}
+
+/*
+ * A worker is active while it has states below the bound or unprocessed
+ * batches, and each active worker and each batch in flight holds one count
+ * in outstanding. A batch's count is taken over by an idle receiver and
+ * released by a busy one, and workers flush everything before going idle,
+ * so the count only reaches zero once there is no work left anywhere.
+ * Idle workers sleep until a batch is sent to them or the search ends.
+ */
+void HDAStarSolver::work(int index)
+{
+    Worker *worker = workers.at(index);
+    QVector<LevelState> nextStates;
+    qint64 expanded = 0;
+    qint64 corralPrunedPushes = 0;
+    PhaseTotals phasesBefore = PhaseTimer::threadTotals();
+    while (!finished.loadAcquire() && !stopRequested.loadAcquire()) {
+        receive(worker);
+        if (worker->frontier.empty() || worker->frontier.top().first >= bestCost.loadAcquire()) {
+            for (int destination = 0; destination < threadCount; ++destination)
+                flush(worker, destination);
+            if (worker->active) {
+                worker->active = false;
+                if (!outstanding.deref()) {
+                    finished.storeRelease(1);
+                    wakeAll();
+                }
+            }
+            // leftover permits are stale, one released after this still
+            // counts; see flush() for why the inbox check is ordered
+            worker->wakeup.tryAcquire(worker->wakeup.available());
+            worker->parked.fetchAndStoreOrdered(1);
+            if (!worker->inbox.fetchAndAddOrdered(0) && !finished.loadAcquire() && !stopRequested.loadAcquire())
+                worker->wakeup.acquire();
+            worker->parked.storeRelease(0);
+            continue;
+        }
+
+        quint32 local = worker->frontier.top().second;
+        worker->frontier.pop();
+        LevelState *state = worker->nodes.at(local);
+        quint32 id = local * quint32(threadCount) + quint32(index);
+        if (++expanded % PublishInterval == 0) {
+            worker->expanded.storeRelease(expanded);
+            worker->generated.storeRelease(worker->nodes.size());
+            worker->bytes.storeRelease(worker->bytesUsed());
+            worker->corralPrunedPushes.storeRelease(corralPrunedPushes);
+            worker->frontierSize.storeRelease(int(worker->frontier.size()));
+            worker->bestFValue.storeRelease(worker->frontier.empty() ? -1 : worker->frontier.top().first);
+            for (int destination = 0; destination < threadCount; ++destination)
+                flush(worker, destination);
+        }
+        if (level->goalReached(state)) {
+            recordGoal(state->cost, id);
+        } else if (worker->table.insertIfCheaper(state)) {
+            corralPrunedPushes += level->nextStatesFor(state, nextStates);
+            for (LevelState &nextState : nextStates) {
+                int heuristic = level->getHeuristic(&nextState);
+                if (heuristic == -1 || nextState.cost + heuristic >= bestCost.loadAcquire())
+                    continue;
+                nextState.previousState = id;
+                int destination = ownerOf(nextState);
+                if (destination == index) {
+                    push(worker, nextState, nextState.cost + heuristic);
+                } else {
+                    Message message = { nextState, nextState.cost + heuristic };
+                    worker->outgoing[destination].append(message);
+                    if (worker->outgoing.at(destination).size() >= BatchSize)
+                        flush(worker, destination);
+                }
+            }
+        }
+    }
+    worker->expanded.storeRelease(expanded);
+    worker->generated.storeRelease(worker->nodes.size());
+    worker->bytes.storeRelease(worker->bytesUsed());
+    worker->corralPrunedPushes.storeRelease(corralPrunedPushes);
+    worker->phases = PhaseTimer::threadTotals() - phasesBefore;
+}
+
+void HDAStarSolver::receive(Worker *worker)
+{
+    MessageBatch *batch = worker->inbox.fetchAndStoreAcquire(nullptr);
+    while (batch) {
+        if (worker->active)
+            outstanding.deref(); // never the last count, this worker holds one
+        else
+            worker->active = true;
+        int bound = bestCost.loadAcquire();
+        for (const Message &message : batch->messages) {
+            if (message.fValue < bound)
+                push(worker, message.state, message.fValue);
+        }
+        MessageBatch *next = batch->next;
+        delete batch;
+        batch = next;
+    }
+}
+
+void HDAStarSolver::push(Worker *worker, const LevelState &state, int fValue)
+{
+    // global ids must stay below NoNode
+    if (quint32(worker->nodes.size()) >= (NodeArena::NoNode - 1) / quint32(threadCount)) {
+        stopRequested.storeRelease(1);
+        wakeAll();
+        return;
+    }
+    worker->frontier.push(Entry(fValue, worker->nodes.allocate(state, state.previousState)));
+}
+
+void HDAStarSolver::flush(Worker *worker, int destination)
+{
+    QVector<Message> &buffer = worker->outgoing[destination];
+    if (buffer.isEmpty())
+        return;
+    MessageBatch *batch = new MessageBatch;
+    batch->messages.swap(buffer);
+    outstanding.ref();
+    QAtomicPointer<MessageBatch> &inbox = workers.at(destination)->inbox;
+    MessageBatch *head;
+    do {
+        head = inbox.loadAcquire();
+        batch->next = head;
+    } while (!inbox.testAndSetOrdered(head, batch));
+    // both sides are ordered, so either the owner sees this batch before it
+    // parks or this sees it parked
+    if (workers.at(destination)->parked.testAndSetOrdered(1, 0))
+        workers.at(destination)->wakeup.release();
+}
+
+void HDAStarSolver::wakeAll()
+{
+    for (Worker *worker : workers)
+        worker->wakeup.release();
+}
+
+void HDAStarSolver::recordGoal(int cost, quint32 id)
+{
+    QMutexLocker locker(&goalMutex);
+    if (cost < bestCost.loadAcquire()) {
+        bestGoal = id;
+        bestCost.storeRelease(cost);
+    }
+}
+
+int HDAStarSolver::ownerOf(const LevelState &state) const
+{
+    // the low bits of a Zobrist key are as good as any, but mix them anyway
+    // so that the owner does not depend on the same bits as qHash
+    quint64 mixed = state.movablesKey * Q_UINT64_C(0x9e3779b97f4a7c15);
+    return int((mixed >> 32) % quint64(threadCount));
+}
+
+SolveStatistics HDAStarSolver::gatherTotals() const
+{
+    SolveStatistics totals = SolveStatistics();
+    for (Worker *worker : workers) {
+        totals.nodesExpanded += worker->expanded.loadAcquire();
+        totals.nodesGenerated += worker->generated.loadAcquire();
+        totals.memoryBytes += worker->bytes.loadAcquire();
+        totals.corralPrunedPushes += worker->corralPrunedPushes.loadAcquire();
+    }
+    return totals;
+}
+
+LevelState *HDAStarSolver::nodeAt(quint32 id) const
+{
+    return workers.at(int(id % quint32(threadCount)))->nodes.at(id / quint32(threadCount));
+}
+
+void HDAStarSolver::clearWorkers()
+{
+    for (Worker *worker : workers) {
+        MessageBatch *batch = worker->inbox.fetchAndStoreAcquire(nullptr);
+        while (batch) {
+            MessageBatch *next = batch->next;
+            delete batch;
+            batch = next;
+        }
+        delete worker;
+    }
+    workers.clear();
+}
+
+bool HDAStarSolver::findsOptimalSolutions() const
+{
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef HDASTARSOLVER_H
+#define HDASTARSOLVER_H
+
+#include "abstractsolver.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QVector>
+
+/*
+ * Hash-distributed A*. Every box configuration is owned by one worker
+ * thread, picked from its Zobrist key, and only that worker keeps the
+ * open list and transposition table entries for states with those boxes.
+ * Workers expand their own best states and hand each child to its owner
+ * through the owner's lock-free inbox, in batches.
+ *
+ * The first goal found is not necessarily the cheapest, so finding one only
+ * sets an upper bound. The search ends once no worker holds a state with an
+ * f-value below that bound and no batch is still in flight, at which point
+ * the bound is the optimal cost, the same one AStarSolver finds.
+ */
+
+class HDAStarSolver : public AbstractSolver
+{
+public:
+    HDAStarSolver(LevelFormat *format, int threadCount = 0); // 0 uses one thread per core
+    ~HDAStarSolver();
+protected:
+    bool solve() override;
+    bool findsOptimalSolutions() const override;
+private:
+    struct Worker;
+    struct Message
+    {
+        LevelState state; // previousState holds the parent's global node id
+        int fValue;
+    };
+    struct MessageBatch
+    {
+        MessageBatch *next;
+        QVector<Message> messages;
+    };
+
+    void work(int index);
+    void receive(Worker *worker);
+    void push(Worker *worker, const LevelState &state, int fValue);
+    void flush(Worker *worker, int destination);
+    void wakeAll(); // after setting finished or stopRequested, so parked workers see it
+    void recordGoal(int cost, quint32 id);
+    int ownerOf(const LevelState &state) const;
+    SolveStatistics gatherTotals() const; // sums the counters the workers last published
+    LevelState *nodeAt(quint32 id) const; // global ids interleave the workers' arenas
+    void clearWorkers();
+
+    int threadCount;
+    QVector<Worker *> workers;
+    QAtomicInt outstanding; // busy workers plus batches in flight, 0 once the search is over
+    QAtomicInt finished;
+    QAtomicInt stopRequested;
+    QAtomicInt bestCost; // cost of the cheapest goal found so far
+    QMutex goalMutex;
+    quint32 bestGoal;
+};
+
+#endif // HDASTARSOLVER_H
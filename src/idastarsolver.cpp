@@ -0,0 +1,202 @@
+#include "idastarsolver.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// stored for states nothing can be reached from within any bound
+const int NoGoalBelow = 0xffff;
+
+}
+
+const qint64 IDAStarSolver::DefaultTableBytes;
+
+IDAStarSolver::IDAStarSolver(LevelFormat *format, qint64 tableBytes) :
+    AbstractSolver (format),
+    tableBytes(tableBytes > 0 ? tableBytes : DefaultTableBytes),
+    tableMask(0),
+    iteration(0)
+{
+
+}
+
+bool IDAStarSolver::solve()
+{
+    // as many buckets as fit in the budget, rounded down to a power of two,
+    // and at most 1 GiB of them since a QVector has to stay under 2 GiB
+    const quint64 maxBuckets = (Q_UINT64_C(1) << 30) / (2 * sizeof(Entry));
+    quint64 buckets = 1;
+    while (buckets * 4 * sizeof(Entry) <= quint64(tableBytes) && buckets < maxBuckets)
+        buckets *= 2;
+    table.fill(Entry(), int(buckets * 2));
+    tableMask = quint32(buckets - 1);
+    iteration = 0;
+    setMemoryProbe([this] { return qint64(table.size()) * qint64(sizeof(Entry)) + qint64(frames.size()) * qint64(sizeof(Frame)); });
+
+    LevelState root = *level->getInitialState();
+    int heuristic = level->getHeuristic(&root);
+    if (heuristic == -1)
+        return false;
+    if (level->goalReached(&root)) {
+        buildSolution(nodes.allocate(root, NodeArena::NoNode));
+        return true;
+    }
+    int bound = heuristic;
+    while (true) {
+        if (++iteration == 0) {
+            // the iteration numbers wrapped around, forget which is which
+            table.fill(Entry());
+            iteration = 1;
+        }
+        if (!enter(0, root, bound))
+            return false;
+        int depth = 0;
+        while (depth >= 0) {
+            Frame &frame = frames[depth];
+            if (frame.nextChild == frame.children.size()) {
+                leave(depth);
+                if (depth > 0) {
+                    Frame &parent = frames[depth - 1];
+                    parent.smallestCutOff = qMin(parent.smallestCutOff, frame.smallestCutOff);
+                    parent.goalBound = qMin(parent.goalBound, frame.goalBound);
+                }
+                --depth;
+                continue;
+            }
+            const Child &child = frame.children.at(frame.nextChild++);
+            if (child.fValue > bound) {
+                frame.smallestCutOff = qMin(frame.smallestCutOff, child.fValue);
+                frame.goalBound = qMin(frame.goalBound, child.fValue);
+                continue;
+            }
+            // copied, as entering may grow frames, which moves the children
+            LevelState nextState = child.state;
+            if (level->goalReached(&nextState)) {
+                buildSolutionPath(depth, nextState);
+                return true;
+            }
+            // already searched in this iteration with at least as much of the
+            // bound left, so whatever was cut off below it counts already,
+            // or on the current path, which makes this a detour
+            Entry *entry = find(keyOf(nextState));
+            if (entry && entry->iteration == iteration && entry->cost <= quint32(nextState.cost)) {
+                frame.goalBound = qMin(frame.goalBound, qMax(bound + 1, nextState.cost + entry->lowerBound));
+                continue;
+            }
+            if (!enter(depth + 1, nextState, bound))
+                return false;
+            ++depth;
+        }
+        if (frames.at(0).smallestCutOff == INT_MAX)
+            return false; // nothing was cut off by the bound, so everything was searched
+        bound = frames.at(0).smallestCutOff;
+    }
+}
+
+/*
+ * Puts a state on the path at the given depth and generates its children,
+ * whose heuristics are raised to whatever earlier iterations proved.
+ */
+bool IDAStarSolver::enter(int depth, const LevelState &state, int bound)
+{
+    if (!keepSearching(depth, bound))
+        return false;
+    if (depth == frames.size())
+        frames.resize(depth + 1);
+    Frame &frame = frames[depth];
+    frame.state = state;
+    frame.nextChild = 0;
+    frame.smallestCutOff = INT_MAX;
+    frame.goalBound = INT_MAX;
+    frame.children.clear();
+    quint64 key = keyOf(state);
+    Entry *entry = find(key);
+    store(key, state.cost, entry ? entry->lowerBound : 0);
+
+    generateNextStates(&frame.state, nextStates);
+    for (LevelState &nextState : nextStates) {
+        int heuristic = level->getHeuristic(&nextState);
+        if (heuristic == -1)
+            continue;
+        Entry *known = find(keyOf(nextState));
+        if (known && known->lowerBound == NoGoalBelow)
+            continue;
+        if (known)
+            heuristic = qMax(heuristic, int(known->lowerBound));
+        Child child = { nextState.cost + heuristic, nextState };
+        frame.children.append(child);
+    }
+    std::stable_sort(frame.children.begin(), frame.children.end(),
+                     [](const Child &a, const Child &b) { return a.fValue < b.fValue; });
+    return true;
+}
+
+/*
+ * Nothing below the state was within the bound, so reaching a goal from it
+ * costs at least as much as it takes to get to the cheapest state that was
+ * cut off. If nothing was, every state below it has been searched.
+ */
+void IDAStarSolver::leave(int depth)
+{
+    const Frame &frame = frames.at(depth);
+    int lowerBound = NoGoalBelow;
+    if (frame.goalBound != INT_MAX)
+        lowerBound = qMin(frame.goalBound - frame.state.cost, NoGoalBelow - 1);
+    store(keyOf(frame.state), frame.state.cost, lowerBound);
+}
+
+IDAStarSolver::Entry *IDAStarSolver::find(quint64 key)
+{
+    Entry *slots = table.data() + (quint32(key) & tableMask) * 2;
+    if (slots[0].key == key)
+        return &slots[0];
+    if (slots[1].key == key)
+        return &slots[1];
+    return nullptr;
+}
+
+/*
+ * Each bucket has two slots. The first keeps the state found closest to
+ * the start in the current iteration, as searching again below it would
+ * cost the most, and hands what it held down to the second, which always
+ * takes the newest state otherwise.
+ */
+void IDAStarSolver::store(quint64 key, int cost, int lowerBound)
+{
+    Entry *slots = table.data() + (quint32(key) & tableMask) * 2;
+    Entry entry = { key, quint32(cost), quint16(lowerBound), iteration };
+    for (int i = 0; i < 2; ++i) {
+        if (slots[i].key == key) {
+            entry.lowerBound = qMax(entry.lowerBound, slots[i].lowerBound);
+            slots[i] = entry;
+            return;
+        }
+    }
+    if (slots[0].key == 0 || slots[0].iteration != iteration || entry.cost <= slots[0].cost) {
+        slots[1] = slots[0];
+        slots[0] = entry;
+    } else {
+        slots[1] = entry;
+    }
+}
+
+quint64 IDAStarSolver::keyOf(const LevelState &state)
+{
+    // the player is not normalized, see the class comment
+    quint64 key = state.movablesKey ^ ((quint64(state.player) + 1) * Q_UINT64_C(0xbf58476d1ce4e5b9));
+    return key ? key : 1;
+}
+
+void IDAStarSolver::buildSolutionPath(int depth, const LevelState &goal)
+{
+    quint32 index = NodeArena::NoNode;
+    for (int i = 0; i <= depth; ++i)
+        index = nodes.allocate(frames.at(i).state, index);
+    buildSolution(nodes.allocate(goal, index));
+}
+
+bool IDAStarSolver::findsOptimalSolutions() const
+{
+    return true;
+}
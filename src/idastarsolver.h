@@ -0,0 +1,71 @@
+#ifndef IDASTARSOLVER_H
+#define IDASTARSOLVER_H
+
+#include "abstractsolver.h"
+#include "levelformat.h"
+
+#include <QVector>
+
+/*
+ * Iterative deepening A*. Each iteration is a depth-first search that cuts
+ * off states whose f-value exceeds a bound, which starts at the initial
+ * heuristic and is raised to the smallest f-value cut off in the iteration
+ * before. Only the current path is kept, so besides it the memory used is
+ * that of a fixed-size transposition table, which remembers for each state
+ * the cheapest cost it was reached at in the current iteration (to skip
+ * states already searched with a bigger budget) and a lower bound on its
+ * remaining cost learned in earlier iterations.
+ *
+ * The table is keyed by the exact box and player positions, so it never
+ * merges states that differ in cost, and finds solutions of the same cost
+ * as AStarSolver. Only the keys' 64-bit hashes are stored; a collision may
+ * cut off a state wrongly, but is astronomically unlikely.
+ */
+
+class IDAStarSolver : public AbstractSolver
+{
+public:
+    static const qint64 DefaultTableBytes = 64 * 1024 * 1024;
+
+    IDAStarSolver(LevelFormat *format, qint64 tableBytes = DefaultTableBytes);
+protected:
+    bool solve() override;
+    bool findsOptimalSolutions() const override;
+private:
+    struct Entry
+    {
+        quint64 key; // 0 for an empty slot
+        quint32 cost; // cheapest the state was reached at in its iteration
+        quint16 lowerBound; // on the cost left to reach a goal
+        quint16 iteration;
+    };
+    struct Child
+    {
+        int fValue;
+        LevelState state;
+    };
+    struct Frame
+    {
+        LevelState state;
+        QVector<Child> children; // by increasing f-value
+        int nextChild;
+        int smallestCutOff; // f-value cut off by the bound below this state
+        int goalBound; // also counting the states cut off by the table
+    };
+
+    bool enter(int depth, const LevelState &state, int bound);
+    void leave(int depth);
+    Entry *find(quint64 key);
+    void store(quint64 key, int cost, int lowerBound);
+    static quint64 keyOf(const LevelState &state);
+    void buildSolutionPath(int depth, const LevelState &goal);
+
+    qint64 tableBytes;
+    QVector<Entry> table; // two-slot buckets, see store()
+    quint32 tableMask;
+    quint16 iteration;
+    QVector<Frame> frames; // the current path, kept to reuse the children vectors
+    QVector<LevelState> nextStates;
+};
+
+#endif // IDASTARSOLVER_H
@@ -1,70 +1,39 @@
 #include "lcfssolver.h"
+#include "bucketqueue.h"
 #include "levelformat.h"
-
-#include <queue>
+#include "transpositiontable.h"
 
 LCFSSolver::LCFSSolver(LevelFormat *format):
     AbstractSolver (format)
 {
-    solved = solve();
+
 }
 
 bool LCFSSolver::solve()
 {
-    QSet<LevelState *> seen;
-    QSet<LevelState *> pruned;
-    auto cmp = [](LevelState *a, LevelState *b) { return a->cost > b->cost; };
-    std::priority_queue<LevelState*, std::vector<LevelState*>, decltype (cmp)> frontier(cmp);
-    frontier.push(level->getInitialState());
-    while (!frontier.empty()) {
-        LevelState *state = frontier.top();
-        frontier.pop();
-        if (pruned.contains(state))
-            continue;
-        else if (level->goalReached(state)) {
-            while (state->previousState) {
-                solution.prepend(state);
-                seen.remove(state);
-                state = state->previousState;
-            }
-            solution.prepend(level->getInitialState());
-            seen.remove(level->getInitialState());
-            for (LevelState *seenState : seen)
-                delete seenState;
-            while (!frontier.empty()) {
-                delete frontier.top();
-                frontier.pop();
-            }
-            solved = true;
+    TranspositionTable table(level);
+    BucketQueue frontier; // by cost, the last generated first among equal ones
+    setMemoryProbe([&] { return table.bytesUsed() + frontier.bytesUsed(); });
+    QVector<LevelState> nextStates;
+    frontier.push(nodes.allocate(*level->getInitialState(), NodeArena::NoNode), 0);
+    while (!frontier.isEmpty()) {
+        quint32 index = frontier.pop();
+        LevelState *state = nodes.at(index);
+        if (!keepSearching(frontier.size(), state->cost))
+            return false;
+        if (level->goalReached(state)) {
+            buildSolution(index);
             return true;
-        } else {
-            bool isNewState = true;
-            for (LevelState *seenState : seen) {
-                if (level->similarTo(state, seenState, qAbs(state->cost - seenState->cost))) {
-                    if (state->cost >= seenState->cost) {
-                        isNewState = false;
-                        break;
-                    } else {
-                        pruned.insert(seenState);
-                    }
-                }
-            }
-            seen.insert(state);
-            if (isNewState) {
-                QSet<LevelState*> *nextStates = level->nextStatesFor(state);
-                if (nextStates) {
-                    for (LevelState *nextState : *nextStates) {
-                        frontier.push(nextState);
-                    }
-                }
-            }
+        } else if (table.insertIfCheaper(state)) {
+            generateNextStates(state, nextStates);
+            for (const LevelState &nextState : nextStates)
+                frontier.push(nodes.allocate(nextState, index), nextState.cost);
         }
     }
-    for (LevelState *seenState : seen)
-        delete seenState;
-    while (!frontier.empty()) {
-        delete frontier.top();
-        frontier.pop();
-    }
     return false;
 }
+
+bool LCFSSolver::findsOptimalSolutions() const
+{
+    return true;
+}
@@ -7,7 +7,9 @@ class LCFSSolver : public AbstractSolver
 {
 public:
     LCFSSolver(LevelFormat *format);
+protected:
     bool solve() override;
+    bool findsOptimalSolutions() const override;
 };
 
 #endif // LCFSSOLVER_H
@@ -0,0 +1,211 @@
+#include "levelcollection.h"
+
+#include <cstdio>
+#include <cstring>
+
+LevelCollection::LevelCollection() :
+    data(nullptr),
+    size(0),
+    position(0),
+    levelsRead(0)
+{
+}
+
+LevelCollection::~LevelCollection()
+{
+    close();
+}
+
+bool LevelCollection::open(const QString &fileName)
+{
+    close();
+    bool opened;
+    if (fileName == "-") {
+        opened = file.open(stdin, QIODevice::ReadOnly);
+    } else {
+        file.setFileName(fileName);
+        opened = file.open(QIODevice::ReadOnly);
+    }
+    if (!opened) {
+        error = file.errorString();
+        return false;
+    }
+    size = fileName == "-" ? 0 : file.size();
+    if (size > 0)
+        data = reinterpret_cast<const char *>(file.map(0, size));
+    if (!data) {
+        // pipes and empty files cannot be mapped
+        buffer = file.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+    return true;
+}
+
+void LevelCollection::close()
+{
+    if (data && buffer.isEmpty())
+        file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+    if (file.isOpen())
+        file.close();
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    position = 0;
+    levelsRead = 0;
+    pendingTitle.clear();
+    currentTitle.clear();
+}
+
+QString LevelCollection::errorString() const
+{
+    return error;
+}
+
+bool LevelCollection::hasNext()
+{
+    QByteArray line;
+    while (position < size) {
+        peekLine(&line);
+        if (isRow(line))
+            return true;
+        readLine(&line);
+        QString title = titleFrom(line);
+        if (!title.isEmpty())
+            pendingTitle = title;
+    }
+    return false;
+}
+
+LevelFormat *LevelCollection::next(QString *error)
+{
+    QList<QByteArray> rows;
+    if (!readRows(&rows)) {
+        if (error)
+            *error = QString("no more levels");
+        return nullptr;
+    }
+    return LevelFormat::fromRows(rows, error);
+}
+
+bool LevelCollection::skip()
+{
+    QList<QByteArray> rows;
+    return readRows(&rows);
+}
+
+int LevelCollection::levelNumber() const
+{
+    return levelsRead;
+}
+
+QString LevelCollection::title() const
+{
+    return currentTitle;
+}
+
+bool LevelCollection::readLine(QByteArray *line)
+{
+    if (position >= size)
+        return false;
+    const char *start = data + position;
+    const char *end = static_cast<const char *>(memchr(start, '\n', size_t(size - position)));
+    qint64 length = end ? end - start : size - position;
+    position += end ? length + 1 : length;
+    while (length > 0 && (start[length - 1] == '\r' || start[length - 1] == ' ' || start[length - 1] == '\t'))
+        --length;
+    *line = QByteArray(start, int(length));
+    return true;
+}
+
+void LevelCollection::peekLine(QByteArray *line)
+{
+    qint64 saved = position;
+    readLine(line);
+    position = saved;
+}
+
+/*
+ * Reads the rows of the next level, then any text up to the level after
+ * it. SOK files put a "Title:" line after the board, which takes priority;
+ * otherwise the last comment or text line before the board is used.
+ */
+bool LevelCollection::readRows(QList<QByteArray> *rows)
+{
+    if (!hasNext())
+        return false;
+    ++levelsRead;
+    currentTitle = pendingTitle;
+    pendingTitle.clear();
+    QByteArray line;
+    while (position < size) {
+        peekLine(&line);
+        if (!isRow(line))
+            break;
+        readLine(&line);
+        appendExpandedRows(line, rows);
+    }
+    while (position < size) {
+        peekLine(&line);
+        if (isRow(line))
+            break;
+        readLine(&line);
+        if (line.toLower().startsWith("title:"))
+            currentTitle = titleFrom(line);
+        else if (!titleFrom(line).isEmpty())
+            pendingTitle = titleFrom(line);
+    }
+    return true;
+}
+
+/*
+ * A board row has at least one wall and nothing but XSB characters,
+ * run-length counts and row separators.
+ */
+bool LevelCollection::isRow(const QByteArray &line)
+{
+    if (!line.contains('#'))
+        return false;
+    for (char c : line) {
+        if (!strchr("#@+$*.-_ |0123456789", c))
+            return false;
+    }
+    return true;
+}
+
+void LevelCollection::appendExpandedRows(const QByteArray &line, QList<QByteArray> *rows)
+{
+    QByteArray row;
+    int count = 0;
+    for (char c : line) {
+        if (c >= '0' && c <= '9') {
+            count = count * 10 + (c - '0');
+        } else if (c == '|') {
+            rows->append(row);
+            row.clear();
+            count = 0;
+        } else {
+            row.append(QByteArray(qMax(count, 1), c));
+            count = 0;
+        }
+    }
+    rows->append(row);
+}
+
+/*
+ * Strips comment markers and a "Title:" prefix. Other "Key: value"
+ * metadata lines (Author:, Comment: ...) are not titles.
+ */
+QString LevelCollection::titleFrom(const QByteArray &line)
+{
+    QByteArray text = line.trimmed();
+    while (text.startsWith(';') || text.startsWith('\''))
+        text = text.mid(1).trimmed();
+    int colon = text.indexOf(':');
+    if (colon > 0 && !text.left(colon).contains(' ')) {
+        if (text.left(colon).toLower() != "title")
+            return QString();
+        text = text.mid(colon + 1).trimmed();
+    }
+    return QString::fromLatin1(text);
+}
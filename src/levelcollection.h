@@ -0,0 +1,67 @@
+#ifndef LEVELCOLLECTION_H
+#define LEVELCOLLECTION_H
+
+#include "levelformat.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+/*
+ * Reads levels one at a time from a text file in XSB/SOK notation, which
+ * may hold any number of levels separated by titles, comments or blank
+ * lines. The file is memory-mapped and only scanned as far as the level
+ * being read, so iterating over a large collection takes constant memory
+ * (standard input cannot be mapped and is read into memory instead).
+ *
+ * Rows may be run-length encoded: a count before a character repeats it,
+ * and | separates rows written on a single line, e.g. 4#|#@$.#|4#.
+ */
+
+class LevelCollection
+{
+public:
+    LevelCollection();
+    ~LevelCollection();
+
+    // "-" reads standard input
+    bool open(const QString &fileName);
+    void close();
+    QString errorString() const;
+
+    // moves past any text before the next level, returns false if there
+    // are no more levels
+    bool hasNext();
+    // the next level with zones built, or nullptr (with the reason in
+    // error) if its rows do not form a valid level; the caller owns it
+    LevelFormat *next(QString *error = nullptr);
+    // moves past the next level without building it
+    bool skip();
+
+    // 1-based number and title of the level last returned or skipped
+    int levelNumber() const;
+    QString title() const;
+private:
+    Q_DISABLE_COPY(LevelCollection)
+
+    bool readLine(QByteArray *line);
+    void peekLine(QByteArray *line);
+    bool readRows(QList<QByteArray> *rows);
+
+    static bool isRow(const QByteArray &line);
+    static void appendExpandedRows(const QByteArray &line, QList<QByteArray> *rows);
+    static QString titleFrom(const QByteArray &line);
+
+    QFile file;
+    QByteArray buffer; // only used when the input cannot be mapped
+    const char *data;
+    qint64 size;
+    qint64 position;
+    int levelsRead;
+    QString pendingTitle;
+    QString currentTitle;
+    QString error;
+};
+
+#endif // LEVELCOLLECTION_H
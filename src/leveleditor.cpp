@@ -37,10 +37,6 @@ LevelItem::Role LevelEditor::getRole() const
 void LevelEditor::setRole(LevelItem::Role role)
 {
     currentRole = role;
-    if (currentLevel) {
-        delete currentLevel;
-        currentLevel = nullptr;
-    }
 }
 
 QPixmap* LevelEditor::getPixmapForRole(LevelItem::Role role) const
@@ -55,8 +51,18 @@ QPixmap* LevelEditor::getPixmapForRole(LevelItem::Role role) const
     }
 }
 
+/*
+ * Editing the level releases its format, so as long as one is kept it still
+ * matches the level and is reused, together with the deadlocks it learned in
+ * earlier solves. The board is reset to the start since the solution steps
+ * through from there.
+ */
 LevelFormat* LevelEditor::getLevelFormat()
 {
+    if (currentLevel) {
+        renderState(currentLevel->getInitialState());
+        return currentLevel;
+    }
     removeItem(snapCursor);
     QRect bounds = itemsBoundingRect().toRect();
     formatOffset = bounds.topLeft();
@@ -68,37 +74,60 @@ LevelFormat* LevelEditor::getLevelFormat()
     for (QGraphicsItem *sceneItem : items()) {
         if (LevelItem *levelItem = static_cast<LevelItem*>(sceneItem)) {
             QPoint itemPos = getAlignedTopLeftPointAt(levelItem->scenePos()) - bounds.topLeft();
-            if (levelItem->getRole() == LevelItem::Player) {
+            switch (levelItem->getRole()) {
+            case LevelItem::Player:
                 if (!playerFound) {
-                    format->setRoleAt(itemPos, LevelItem::Player);
+                    format->setTileAt(itemPos, LevelFormat::Player);
                     playerFound = true;
                 } else {
                     addItem(snapCursor);
+                    delete format;
                     return nullptr;
                 }
-            } else {
-                format->setRoleAt(itemPos, levelItem->getRole());
-                if (levelItem->getRole() == LevelItem::Movable) {
-                    ++movablesAdded;
-                }
-                else if (levelItem->getRole() == LevelItem::Goal) {
-                    ++goalsAdded;
-                }
-                else if (levelItem->getRole() == LevelItem::MovableOnGoal) {
-                    ++movablesAdded;
-                    ++goalsAdded;
-                }
+                break;
+            case LevelItem::Wall:
+                format->setTileAt(itemPos, LevelFormat::Wall);
+                break;
+            case LevelItem::Movable:
+                format->setTileAt(itemPos, LevelFormat::Movable);
+                ++movablesAdded;
+                break;
+            case LevelItem::MovableOnGoal:
+                format->setTileAt(itemPos, LevelFormat::MovableOnGoal);
+                ++movablesAdded;
+                ++goalsAdded;
+                break;
+            case LevelItem::Goal:
+                format->setTileAt(itemPos, LevelFormat::Goal);
+                ++goalsAdded;
+                break;
+            default: break;
             }
         }
     }
     addItem(snapCursor);
-    if (goalsAdded != movablesAdded || !playerFound)
+    if (goalsAdded != movablesAdded || !playerFound) {
+        delete format;
         return nullptr;
+    }
     format->buildZones();
     currentLevel = format;
     return format;
 }
 
+/*
+ * Listeners of solveInterrupted must stop using the format before
+ * returning, since it is deleted right after.
+ */
+void LevelEditor::releaseLevelFormat()
+{
+    if (currentLevel) {
+        emit solveInterrupted();
+        delete currentLevel;
+        currentLevel = nullptr;
+    }
+}
+
 void LevelEditor::renderState(LevelState *state)
 {
     removeItem(snapCursor);
@@ -113,8 +142,9 @@ void LevelEditor::renderState(LevelState *state)
     LevelItem *newItem = new LevelItem(this);
     addItem(newItem);
     newItem->setRole(LevelItem::Player);
-    newItem->setPos(state->player * iconSize + formatOffset);
-    for (QPoint pos : state->movables) {
+    newItem->setPos(currentLevel->pointAt(state->player) * iconSize + formatOffset);
+    for (int cell = state->movables.first(); cell != -1; cell = state->movables.next(cell)) {
+        QPoint pos = currentLevel->pointAt(cell);
         QList<QGraphicsItem*> maybeMovableHere = items(pos * iconSize + formatOffset, Qt::IntersectsItemShape, Qt::AscendingOrder);
         if (maybeMovableHere.size() == 1) {
             QGraphicsItem *sceneItem = maybeMovableHere.first();
@@ -133,6 +163,7 @@ void LevelEditor::renderState(LevelState *state)
 
 void LevelEditor::requestClear()
 {
+    releaseLevelFormat();
     removeItem(snapCursor); // we remove this because clear() deletes all items
     clear();
     addItem(snapCursor);
@@ -153,10 +184,7 @@ const QRect LevelEditor::getAlignedRectAt(const QPointF &pos) const
 void LevelEditor::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
 {
     if (mouseEvent->buttons() & (Qt::LeftButton | Qt::RightButton) && sceneRect().contains(mouseEvent->scenePos())) {
-        if (currentLevel) {
-            setRole(currentRole); // triggers deletion of active level format
-            emit solveInterrupted();
-        }
+        releaseLevelFormat();
         QList<QGraphicsItem *> sceneItems = items(mouseEvent->scenePos(), Qt::IntersectsItemShape, Qt::AscendingOrder);
         if (sceneItems.size() == 1 && mouseEvent->buttons() & Qt::LeftButton) {
             if (currentRole == LevelItem::Erase) return;
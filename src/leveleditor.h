@@ -23,10 +23,11 @@ public:
     void setRole(LevelItem::Role role);
     QPixmap *getPixmapForRole(LevelItem::Role role) const;
     LevelFormat *getLevelFormat();
+    void releaseLevelFormat(); // emits solveInterrupted first if there is one
     void renderState(LevelState *state);
     void requestClear();
 signals:
-    void solveInterrupted();
+    void solveInterrupted(); // the current level format is about to be deleted
 private:
     const QPoint getAlignedTopLeftPointAt(const QPointF &pos) const; // in tile coordinates
     const QRect getAlignedRectAt(const QPointF &pos) const; // in pixel coordinates
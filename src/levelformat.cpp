@@ -1,37 +1,168 @@
 #include "levelformat.h"
+#include "boxmatching.h"
+#include "deadlockpatterns.h"
+#include "nodearena.h"
+#include "phasecounters.h"
 
-#include <QQueue>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
 #include <QtDebug>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace {
+
+// tells the levels apart in the matching caches, which outlive them
+QAtomicInt lastLevelId(0);
+
+/*
+ * Every thread keeps the matching of the state it last expanded, so that
+ * the heuristic of each of its successors, which only moved one box, can
+ * be updated from it. Several threads may be solving the same level.
+ */
+struct MatchingCache
+{
+    MatchingCache() : levelId(0) {}
+
+    int levelId;
+    BoxMatching parent;
+    BoxMatching child;
+};
+
+MatchingCache &matchingCacheFor(int levelId, const quint16 *pushDistances, int goalCount)
+{
+    thread_local MatchingCache cache;
+    if (cache.levelId != levelId) {
+        cache.parent = BoxMatching(pushDistances, goalCount);
+        cache.child = cache.parent;
+        cache.levelId = levelId;
+    }
+    return cache;
+}
+
+}
 
 LevelFormat::LevelFormat(int h, int w) :
+    levelId(0),
+    deadlockPatterns(nullptr),
+    macroMoves(true),
+    corralPruning(true),
     height(h - 1),
     width(w - 1)
 {
+    Q_ASSERT(height * width <= Bitboard::MaxCells);
     initialState = new LevelState;
-    initialState->previousState = nullptr;
+    initialState->player = -1;
+    initialState->previousState = 0xffffffffu; // no parent, see NodeArena::NoNode
     initialState->cost = 0;
+    initialState->movablesKey = 0;
 }
 
-void LevelFormat::setRoleAt(QPoint pos, LevelItem::Role role)
+LevelFormat::~LevelFormat()
+{
+    delete initialState;
+    delete deadlockPatterns;
+}
+
+/*
+ * Builds a ready-to-solve level from rows in the standard XSB notation:
+ * # wall, @ player, + player on goal, $ box, * box on goal, . goal, and
+ * space, - or _ for floor. The level must have exactly one player and as
+ * many boxes as goals, and must fit in a bitboard.
+ */
+LevelFormat *LevelFormat::fromRows(const QList<QByteArray> &rows, QString *error)
 {
-    switch(role) {
-    case LevelItem::Player:
-        initialState->player = pos;
+    int rowLength = 0;
+    for (const QByteArray &row : rows)
+        rowLength = qMax(rowLength, row.size());
+    if (rows.isEmpty() || rows.size() * rowLength > Bitboard::MaxCells) {
+        if (error)
+            *error = QString("level must have between 1 and %1 cells").arg(Bitboard::MaxCells);
+        return nullptr;
+    }
+    // the constructor takes sizes one larger than the playable area
+    LevelFormat *format = new LevelFormat(rows.size() + 1, rowLength + 1);
+    int players = 0;
+    int movables = 0;
+    int goals = 0;
+    for (int y = 0; y < rows.size(); ++y) {
+        const QByteArray &row = rows.at(y);
+        for (int x = 0; x < row.size(); ++x) {
+            QPoint pos(x, y);
+            switch (row.at(x)) {
+            case '#':
+                format->setTileAt(pos, Wall);
+                break;
+            case '@':
+                format->setTileAt(pos, Player);
+                ++players;
+                break;
+            case '+':
+                format->setTileAt(pos, Player);
+                format->setTileAt(pos, Goal);
+                ++players;
+                ++goals;
+                break;
+            case '$':
+                format->setTileAt(pos, Movable);
+                ++movables;
+                break;
+            case '*':
+                format->setTileAt(pos, MovableOnGoal);
+                ++movables;
+                ++goals;
+                break;
+            case '.':
+                format->setTileAt(pos, Goal);
+                ++goals;
+                break;
+            case ' ':
+            case '-':
+            case '_':
+                break;
+            default:
+                if (error)
+                    *error = QString("unexpected character '%1' in row %2").arg(QString(QChar(row.at(x)))).arg(y + 1);
+                delete format;
+                return nullptr;
+            }
+        }
+    }
+    if (players != 1 || movables != goals || movables == 0) {
+        if (error)
+            *error = QString("level needs exactly one player and as many boxes as goals");
+        delete format;
+        return nullptr;
+    }
+    format->buildZones();
+    return format;
+}
+
+void LevelFormat::setTileAt(QPoint pos, Tile tile)
+{
+    if (pos.x() < 0 || pos.x() >= width || pos.y() < 0 || pos.y() >= height)
+        return;
+    int cell = cellAt(pos);
+    switch(tile) {
+    case Player:
+        initialState->player = cell;
         break;
-    case LevelItem::Wall:
-        walls.insert(pos);
+    case Wall:
+        walls.set(cell);
         break;
-    case LevelItem::Movable:
-        initialState->movables.insert(pos);
+    case Movable:
+        initialState->movables.set(cell);
         break;
-    case LevelItem::MovableOnGoal:
-        initialState->movables.insert(pos);
-        goals.insert(pos);
+    case MovableOnGoal:
+        initialState->movables.set(cell);
+        goals.set(cell);
         break;
-    case LevelItem::Goal:
-        goals.insert(pos);
+    case Goal:
+        goals.set(cell);
         break;
-    default: return;
     }
 }
 
@@ -56,6 +187,9 @@ void LevelFormat::setRoleAt(QPoint pos, LevelItem::Role role)
  */
 void LevelFormat::buildZones()
 {
+    buildCellGraph();
+    buildZobristKeys();
+
     int lastStart = 0;
     bool upBlocked = true;
     bool downBlocked = true;
@@ -63,13 +197,13 @@ void LevelFormat::buildZones()
     for (int i = 0; i < width; ++i) {
         for (int j = 0; j < height; ++j) {
             if (!upBlocked && !downBlocked) {
-                while (isValid(QPoint(i, j)) && !walls.contains(QPoint(i, j)))
+                while (isValid(QPoint(i, j)) && !walls.test(cellAt(QPoint(i, j))))
                     ++j;
-            } else if (walls.contains(QPoint(i, j))) {
+            } else if (walls.test(cellAt(QPoint(i, j)))) {
                 if (lastStart != j && (upBlocked || downBlocked)) {
                     if (goalsSeen == 0) {
                         for (int k = lastStart; k < j; ++k)
-                            forbiddenZones << QPoint(i, k);
+                            forbiddenZones.set(cellAt(QPoint(i, k)));
                     } else {
                         LimitedZone zone;
                         zone.line = i;
@@ -85,7 +219,7 @@ void LevelFormat::buildZones()
                 downBlocked = true;
                 goalsSeen = 0;
             } else {
-                if (goals.contains(QPoint(i, j)))
+                if (goals.test(cellAt(QPoint(i, j))))
                     ++goalsSeen;
                 upBlocked = upBlocked && !isValid(QPoint(i - 1, j));
                 downBlocked = downBlocked && !isValid(QPoint(i + 1, j));
@@ -94,7 +228,7 @@ void LevelFormat::buildZones()
         if (lastStart != height && (upBlocked || downBlocked)) {
             if (goalsSeen == 0) {
                 for (int k = lastStart; k < height; ++k)
-                    forbiddenZones << QPoint(i, k);
+                    forbiddenZones.set(cellAt(QPoint(i, k)));
             } else {
                 LimitedZone zone;
                 zone.line = i;
@@ -115,13 +249,13 @@ void LevelFormat::buildZones()
     for (int j = 0; j < height; ++j) {
         for (int i = 0; i < width; ++i) {
             if (!leftBlocked && !rightBlocked) {
-                while (isValid(QPoint(i, j)) && !walls.contains(QPoint(i, j)))
+                while (isValid(QPoint(i, j)) && !walls.test(cellAt(QPoint(i, j))))
                     ++i;
-            } else if (walls.contains(QPoint(i, j))) {
+            } else if (walls.test(cellAt(QPoint(i, j)))) {
                 if (lastStart != i && (leftBlocked || rightBlocked)) {
                     if (goalsSeen == 0) {
                         for (int k = lastStart; k < i; ++k)
-                            forbiddenZones << QPoint(k, j);
+                            forbiddenZones.set(cellAt(QPoint(k, j)));
                     } else {
                         LimitedZone zone;
                         zone.line = j;
@@ -137,7 +271,7 @@ void LevelFormat::buildZones()
                 rightBlocked = true;
                 goalsSeen = 0;
             } else {
-                if (goals.contains(QPoint(i, j)))
+                if (goals.test(cellAt(QPoint(i, j))))
                     ++goalsSeen;
                 leftBlocked = leftBlocked && !isValid(QPoint(i, j - 1));
                 rightBlocked = rightBlocked && !isValid(QPoint(i, j + 1));
@@ -146,7 +280,7 @@ void LevelFormat::buildZones()
         if (lastStart != width && (leftBlocked || rightBlocked)) {
             if (goalsSeen == 0) {
                 for (int k = lastStart; k < width; ++k)
-                    forbiddenZones << QPoint(k, j);
+                    forbiddenZones.set(cellAt(QPoint(k, j)));
             } else {
                 LimitedZone zone;
                 zone.line = j;
@@ -162,6 +296,421 @@ void LevelFormat::buildZones()
         rightBlocked = true;
         goalsSeen = 0;
     }
+    for (LimitedZone &zone : limitedZones) {
+        for (int k = zone.start; k < zone.end; ++k)
+            zone.cells.set(zone.horizontal ? cellAt(QPoint(zone.line, k)) : cellAt(QPoint(k, zone.line)));
+    }
+    buildPushDistances();
+    buildDeadSquares();
+    buildDeadlockPatterns();
+    buildMacroCells();
+    buildStartReachableCells();
+}
+
+/*
+ * Precomputes, for every cell, which cells can be entered from it, so that
+ * the hot paths only ever deal with integer cell ids and never have to
+ * check bounds or walls again.
+ */
+void LevelFormat::buildCellGraph()
+{
+    neighbours.fill(-1, height * width * 4);
+    floor = Bitboard();
+    usedWords = (height * width + 63) / 64;
+    for (int direction = Left; direction <= Down; ++direction) {
+        for (int i = 0; i < Bitboard::Words; ++i)
+            stepSources[direction][i] = 0;
+    }
+    for (int cell = 0; cell < height * width; ++cell) {
+        QPoint pos = pointAt(cell);
+        if (!isValid(pos))
+            continue;
+        floor.set(cell);
+        QPoint nextPoints[4] = {
+            QPoint(pos.x() - 1, pos.y()),
+            QPoint(pos.x() + 1, pos.y()),
+            QPoint(pos.x(), pos.y() - 1),
+            QPoint(pos.x(), pos.y() + 1)
+        };
+        for (int direction = Left; direction <= Down; ++direction) {
+            if (isValid(nextPoints[direction])) {
+                neighbours[cell * 4 + direction] = cellAt(nextPoints[direction]);
+                stepSources[direction][cell >> 6] |= quint64(1) << (cell & 63);
+            }
+        }
+    }
+}
+
+/*
+ * For every cell, numbers the areas the player can be in around a box
+ * standing there: two sides of the box have the same number if the player
+ * can walk from one to the other without pushing it (other boxes are not
+ * taken into account). Sides facing a wall are -1.
+ */
+QVector<qint8> LevelFormat::sideAreas() const
+{
+    QVector<qint8> areas(height * width * 4, -1);
+    QVector<int> visitedBy(height * width, -1);
+    int queue[Bitboard::MaxCells];
+    for (int movable = floor.first(); movable != -1; movable = floor.next(movable)) {
+        for (int side = Left; side <= Down; ++side) {
+            int start = neighbourOf(movable, Direction(side));
+            if (start == -1 || areas.at(movable * 4 + side) != -1)
+                continue;
+            // visitedBy tells which side's flood fill reached a cell last,
+            // so it never has to be cleared
+            int fill = movable * 4 + side;
+            int queueEnd = 0;
+            queue[queueEnd++] = start;
+            visitedBy[start] = fill;
+            for (int queueStart = 0; queueStart < queueEnd; ++queueStart) {
+                for (int direction = Left; direction <= Down; ++direction) {
+                    int nextCell = neighbourOf(queue[queueStart], Direction(direction));
+                    if (nextCell != -1 && nextCell != movable && visitedBy.at(nextCell) != fill) {
+                        visitedBy[nextCell] = fill;
+                        queue[queueEnd++] = nextCell;
+                    }
+                }
+            }
+            for (int other = side; other <= Down; ++other) {
+                int cell = neighbourOf(movable, Direction(other));
+                if (cell != -1 && visitedBy.at(cell) == fill)
+                    areas[movable * 4 + other] = qint8(side);
+            }
+        }
+    }
+    return areas;
+}
+
+/*
+ * Finds the number of pushes a lone box needs to get from every cell to
+ * every goal, by pulling a box backwards from each goal. The search tracks
+ * which side of the box the player is on: the player can walk to any side
+ * in the same area for free, and can pull the box from a cell into the
+ * neighbour on its side if there is room to step back beyond it. Sides
+ * cost 0 and pulls 1, so a double-ended queue keeps the search in order.
+ * A cell's distance is that of its best side, as the boxes of a state do
+ * not say where the player is. Other boxes are not taken into account, so
+ * the distances may be too small, but never too large.
+ */
+void LevelFormat::buildPushDistances()
+{
+    int goalCount = goals.count();
+    int cells = height * width;
+    pushDistances.fill(BoxMatching::Unreachable, cells * goalCount);
+    QVector<qint8> areas = sideAreas();
+    QVector<quint16> sideDistances(cells * 4);
+    // each position is queued at most once at its final distance and once
+    // more before that, a ring buffer of twice that is plenty
+    QVector<int> queue(cells * 4 * 2 + 1);
+    int goalIndex = 0;
+    for (int goal = goals.first(); goal != -1; goal = goals.next(goal), ++goalIndex) {
+        sideDistances.fill(BoxMatching::Unreachable);
+        int queueStart = 0, queueEnd = 0;
+        auto pushFront = [&](int position) {
+            queueStart = (queueStart + queue.size() - 1) % queue.size();
+            queue[queueStart] = position;
+        };
+        auto pushBack = [&](int position) {
+            queue[queueEnd] = position;
+            queueEnd = (queueEnd + 1) % queue.size();
+        };
+        for (int side = Left; side <= Down; ++side) {
+            if (areas.at(goal * 4 + side) != -1) {
+                sideDistances[goal * 4 + side] = 0;
+                pushBack(goal * 4 + side);
+            }
+        }
+        while (queueStart != queueEnd) {
+            int position = queue.at(queueStart);
+            queueStart = (queueStart + 1) % queue.size();
+            int movable = position / 4;
+            int side = position % 4;
+            quint16 distance = sideDistances.at(position);
+            for (int other = Left; other <= Down; ++other) {
+                if (other != side && areas.at(movable * 4 + other) == areas.at(position)
+                        && sideDistances.at(movable * 4 + other) > distance) {
+                    sideDistances[movable * 4 + other] = distance;
+                    pushFront(movable * 4 + other);
+                }
+            }
+            int pulledTo = neighbourOf(movable, Direction(side));
+            if (neighbourOf(pulledTo, Direction(side)) != -1
+                    && sideDistances.at(pulledTo * 4 + side) > distance + 1) {
+                sideDistances[pulledTo * 4 + side] = quint16(distance + 1);
+                pushBack(pulledTo * 4 + side);
+            }
+        }
+        quint16 *distances = pushDistances.data();
+        for (int cell = floor.first(); cell != -1; cell = floor.next(cell)) {
+            for (int side = Left; side <= Down; ++side)
+                distances[cell * goalCount + goalIndex] = qMin(distances[cell * goalCount + goalIndex], sideDistances.at(cell * 4 + side));
+        }
+        distances[goal * goalCount + goalIndex] = 0;
+    }
+    levelId = lastLevelId.fetchAndAddRelaxed(1) + 1;
+}
+
+/*
+ * The dead squares are the cells from which a lone box cannot be pushed to
+ * any goal. Like the push distances, this errs on the side of live cells.
+ */
+void LevelFormat::buildDeadSquares()
+{
+    int goalCount = goals.count();
+    Bitboard live;
+    for (int cell = floor.first(); cell != -1; cell = floor.next(cell)) {
+        for (int goalIndex = 0; goalIndex < goalCount; ++goalIndex) {
+            if (pushDistances.at(cell * goalCount + goalIndex) != BoxMatching::Unreachable) {
+                live.set(cell);
+                break;
+            }
+        }
+    }
+    deadSquares = (floor & ~live) | forbiddenZones;
+}
+
+/*
+ * Precomputes the small freeze deadlocks: every connected group of two to
+ * MaxPrecomputedBoxes boxes (so anything fitting a 2x2 up to a 4x4 window)
+ * that blockExists finds stuck on its own. Groups containing a dead square
+ * or a smaller pattern are skipped, as they are rejected anyway.
+ */
+void LevelFormat::buildDeadlockPatterns()
+{
+    delete deadlockPatterns;
+    deadlockPatterns = new DeadlockPatterns(height * width);
+    LevelState probe;
+    probe.player = -1;
+    for (int anchor = floor.first(); anchor != -1; anchor = floor.next(anchor)) {
+        if (deadSquares.test(anchor))
+            continue;
+        QVector<Bitboard> groups;
+        Bitboard single;
+        single.set(anchor);
+        groups.append(single);
+        for (int size = 2; size <= MaxPrecomputedBoxes; ++size) {
+            // grow each group by one cell after the anchor, so every
+            // group is only generated under its lowest cell
+            QSet<Bitboard> seen;
+            QVector<Bitboard> grown;
+            for (const Bitboard &group : groups) {
+                for (int cell = group.first(); cell != -1; cell = group.next(cell)) {
+                    for (int direction = Left; direction <= Down; ++direction) {
+                        int nextCell = neighbourOf(cell, Direction(direction));
+                        if (nextCell <= anchor || group.test(nextCell) || deadSquares.test(nextCell))
+                            continue;
+                        Bitboard larger = group;
+                        larger.set(nextCell);
+                        if (seen.contains(larger))
+                            continue;
+                        seen.insert(larger);
+                        if (deadlockPatterns->matches(larger))
+                            continue;
+                        probe.movables = larger;
+                        if (blockExists(&probe))
+                            deadlockPatterns->addPrecomputed(larger);
+                        else
+                            grown.append(larger);
+                    }
+                }
+            }
+            groups = grown;
+        }
+    }
+}
+
+/*
+ * Called when blockExists has found a deadlock: stores the group of
+ * frozen boxes around one that is off its goal, if that group is small
+ * and stuck even with every other box gone.
+ */
+void LevelFormat::learnDeadlock(const Bitboard &frozen) const
+{
+    int start = (frozen & ~goals).first();
+    if (start == -1)
+        return;
+    Bitboard group;
+    group.set(start);
+    int cellsStack[Bitboard::MaxCells];
+    int top = 0;
+    cellsStack[top++] = start;
+    int size = 1;
+    while (top) {
+        int cell = cellsStack[--top];
+        for (int direction = Left; direction <= Down; ++direction) {
+            int nextCell = neighbourOf(cell, Direction(direction));
+            if (nextCell != -1 && frozen.test(nextCell) && !group.test(nextCell)) {
+                if (++size > MaxLearnedBoxes)
+                    return;
+                group.set(nextCell);
+                cellsStack[top++] = nextCell;
+            }
+        }
+    }
+    LevelState probe;
+    probe.movables = group;
+    probe.player = -1;
+    if (size > 1 && blockExists(&probe))
+        deadlockPatterns->learn(group);
+}
+
+/*
+ * Tunnel cells are walled in on both sides across the direction of a push,
+ * so a box in one can only ever move along it.
+ *
+ * A goal room is an area holding goals that can only be entered through a
+ * single cell, its entrance, and that holds no box off a goal at the start.
+ * Its goals are filled deepest first, counting from the entrance, so that
+ * the boxes already in place usually do not stand in the way of the next
+ * ones. Areas where that order does not work, often because the player
+ * needs room to move in them, are left alone.
+ */
+void LevelFormat::buildMacroCells()
+{
+    for (int axis = 0; axis < 2; ++axis)
+        tunnelCells[axis] = Bitboard();
+    for (int cell = floor.first(); cell != -1; cell = floor.next(cell)) {
+        if (neighbourOf(cell, Up) == -1 && neighbourOf(cell, Down) == -1)
+            tunnelCells[Left / 2].set(cell);
+        if (neighbourOf(cell, Left) == -1 && neighbourOf(cell, Right) == -1)
+            tunnelCells[Up / 2].set(cell);
+    }
+
+    goalRooms.clear();
+    goalRoomAt.fill(-1, height * width);
+    Bitboard looseMovables = initialState->movables & ~goals;
+    int cellsQueue[Bitboard::MaxCells];
+    int depths[Bitboard::MaxCells];
+    for (int entrance = floor.first(); entrance != -1; entrance = floor.next(entrance)) {
+        Bitboard seen;
+        seen.set(entrance);
+        QList<Bitboard> areas;
+        for (int side = Left; side <= Down; ++side) {
+            int start = neighbourOf(entrance, Direction(side));
+            if (start == -1 || seen.test(start))
+                continue;
+            Bitboard area;
+            int head = 0;
+            int tail = 0;
+            cellsQueue[tail++] = start;
+            depths[start] = 1;
+            seen.set(start);
+            area.set(start);
+            while (head != tail) {
+                int cell = cellsQueue[head++];
+                for (int direction = Left; direction <= Down; ++direction) {
+                    int nextCell = neighbourOf(cell, Direction(direction));
+                    if (nextCell != -1 && !seen.test(nextCell)) {
+                        seen.set(nextCell);
+                        area.set(nextCell);
+                        depths[nextCell] = depths[cell] + 1;
+                        cellsQueue[tail++] = nextCell;
+                    }
+                }
+            }
+            areas.append(area);
+        }
+        // without at least two areas, the entrance is not the only way in
+        if (areas.size() < 2)
+            continue;
+        for (const Bitboard &area : areas) {
+            if ((area & goals).none() || (area & looseMovables).any())
+                continue;
+            GoalRoom room;
+            room.entrance = entrance;
+            room.cells = area;
+            Bitboard roomGoals = area & goals;
+            for (int goal = roomGoals.first(); goal != -1; goal = roomGoals.next(goal))
+                room.fillOrder.append(goal);
+            std::stable_sort(room.fillOrder.begin(), room.fillOrder.end(),
+                             [&depths](int a, int b) { return depths[a] > depths[b]; });
+            if (!canFill(room))
+                continue;
+            goalRoomAt[entrance] = goalRooms.size();
+            goalRooms.append(room);
+        }
+    }
+}
+
+/*
+ * Tries to fill the goals of a room in order with boxes brought in through
+ * the entrance, the player leaving the room after each one.
+ */
+bool LevelFormat::canFill(const GoalRoom &room) const
+{
+    int outside = -1;
+    for (int side = Left; side <= Down && outside == -1; ++side) {
+        int cell = neighbourOf(room.entrance, Direction(side));
+        if (cell != -1 && !room.cells.test(cell))
+            outside = cell;
+    }
+    LevelState probe;
+    probe.player = outside;
+    for (int goal : room.fillOrder) {
+        probe.movables.set(room.entrance);
+        int player;
+        if (boxMoves(&probe, room.entrance, goal, &player).isEmpty())
+            return false;
+        probe.movables.reset(room.entrance);
+        probe.movables.set(goal);
+        QByteArray moves;
+        if (!walkMoves(&probe, player, outside, &moves))
+            return false;
+        probe.player = outside;
+    }
+    return true;
+}
+
+/*
+ * Pushes the boxes of the initial state around on their own, as far as
+ * they go. The backward search never pulls a box anywhere else, since no
+ * box could get there.
+ */
+void LevelFormat::buildStartReachableCells()
+{
+    startReachable = initialState->movables;
+    int queue[Bitboard::MaxCells];
+    int queueEnd = 0;
+    for (int movable = startReachable.first(); movable != -1; movable = startReachable.next(movable))
+        queue[queueEnd++] = movable;
+    for (int queueStart = 0; queueStart < queueEnd; ++queueStart) {
+        int movable = queue[queueStart];
+        for (int direction = Left; direction <= Down; ++direction) {
+            int pushedTo = neighbourOf(movable, Direction(direction));
+            if (pushedTo == -1 || startReachable.test(pushedTo) || neighbourOf(movable, Direction(direction ^ 1)) == -1)
+                continue;
+            startReachable.set(pushedTo);
+            queue[queueEnd++] = pushedTo;
+        }
+    }
+}
+
+/*
+ * Assigns every cell a random key for a box and one for a normalized player
+ * standing there, and hashes the initial boxes. Keys of later states are
+ * then updated incrementally as boxes move. A fixed seed keeps the keys
+ * (and so the search order) the same from run to run.
+ */
+void LevelFormat::buildZobristKeys()
+{
+    quint64 seed = Q_UINT64_C(0x9e3779b97f4a7c15);
+    auto nextKey = [&seed]() {
+        // splitmix64
+        quint64 key = (seed += Q_UINT64_C(0x9e3779b97f4a7c15));
+        key = (key ^ (key >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        key = (key ^ (key >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+        return key ^ (key >> 31);
+    };
+    movableZobristKeys.resize(height * width);
+    playerZobristKeys.resize(height * width);
+    for (int cell = 0; cell < height * width; ++cell) {
+        movableZobristKeys[cell] = nextKey();
+        playerZobristKeys[cell] = nextKey();
+    }
+    initialState->movablesKey = 0;
+    for (int movable = initialState->movables.first(); movable != -1; movable = initialState->movables.next(movable))
+        initialState->movablesKey ^= movableZobristKeys.at(movable);
 }
 
 LevelState* LevelFormat::getInitialState() const
@@ -169,59 +718,146 @@ LevelState* LevelFormat::getInitialState() const
     return initialState;
 }
 
+void LevelFormat::setMacroMoves(bool enabled)
+{
+    macroMoves = enabled;
+}
+
+void LevelFormat::setCorralPruning(bool enabled)
+{
+    corralPruning = enabled;
+}
+
 /*
  * Finds the next possible states for a given state. Note that the next
  * states are the possible ways boxes can be moved, and not the possible
- * ways the player can move.
- */
-QSet<LevelState*> *LevelFormat::nextStatesFor(LevelState *state) const
-{
-    QSet<LevelState*> *nextStates = new QSet<LevelState*>;
-    QHash<QPoint, int> *reachablePoints = getReachablePointsWithCosts(state);
-    for (QPoint movable : state->movables) {
-        QPoint leftPoint = QPoint(movable.x() - 1, movable.y());
-        QPoint rightPoint = QPoint(movable.x() + 1, movable.y());
-        QPoint upPoint = QPoint(movable.x(), movable.y() - 1);
-        QPoint downPoint = QPoint(movable.x(), movable.y() + 1);
-        if (reachablePoints->contains(leftPoint) && isValid(state, rightPoint)) {
-            LevelState *newState = new LevelState(*state);
-            newState->movables.remove(movable);
-            newState->movables.insert(rightPoint);
-            newState->player = movable;
-            newState->cost = state->cost + reachablePoints->value(leftPoint) + 1;
-            newState->previousState = state;
-            nextStates->insert(newState);
-        }
-        if (reachablePoints->contains(rightPoint) && isValid(state, leftPoint)) {
-            LevelState *newState = new LevelState(*state);
-            newState->movables.remove(movable);
-            newState->movables.insert(leftPoint);
-            newState->player = movable;
-            newState->cost = state->cost + reachablePoints->value(rightPoint) + 1;
-            newState->previousState = state;
-            nextStates->insert(newState);
-        }
-        if (reachablePoints->contains(upPoint) && isValid(state, downPoint)) {
-            LevelState *newState = new LevelState(*state);
-            newState->movables.remove(movable);
-            newState->movables.insert(downPoint);
-            newState->player = movable;
-            newState->cost = state->cost + reachablePoints->value(upPoint) + 1;
-            newState->previousState = state;
-            nextStates->insert(newState);
-        }
-        if (reachablePoints->contains(downPoint) && isValid(state, upPoint)) {
-            LevelState *newState = new LevelState(*state);
-            newState->movables.remove(movable);
-            newState->movables.insert(upPoint);
-            newState->player = movable;
-            newState->cost = state->cost + reachablePoints->value(downPoint) + 1;
-            newState->previousState = state;
-            nextStates->insert(newState);
-        }
-    }
-    delete reachablePoints;
-    return nextStates;
+ * ways the player can move. If the state has an unsolved PI-corral, only
+ * pushes of its fence are generated, and the number of pushes left out
+ * for that reason is returned. This keeps solutions as short in pushes but
+ * not always in moves, so it can be turned off with setCorralPruning.
+ *
+ * Some pushes are macro moves made of several pushes of the same box: a
+ * box pushed into a tunnel is pushed on until it comes out of it, since it
+ * can only ever be pushed along it, and a box pushed into a goal room is
+ * taken straight to the next free goal of the room. They spare the search
+ * the states in between, but can make solutions longer, and the goal room
+ * one is not guaranteed to keep every solution, so they can be turned off
+ * with setMacroMoves.
+ */
+int LevelFormat::nextStatesFor(LevelState *state, QVector<LevelState> &nextStates) const
+{
+    PhaseTimer timer(PhaseTotals::NextStates);
+    nextStates.clear();
+    // the heuristics of the next states are updated from this one's
+    MatchingCache &cache = matchingCacheFor(levelId, pushDistances.constData(), goals.count());
+    if (!cache.parent.update(state->movables))
+        cache.parent.solve(state->movables);
+    PlayerReach reach;
+    getPlayerReach(state, &reach);
+    const Bitboard &reachable = reach.cells();
+    Bitboard pushable = state->movables;
+    if (corralPruning)
+        findPICorral(state, reachable, &pushable);
+    int pruned = 0;
+    for (int movable = state->movables.first(); movable != -1; movable = state->movables.next(movable)) {
+        int neighbours[4];
+        for (int direction = Left; direction <= Down; ++direction)
+            neighbours[direction] = neighbourOf(movable, Direction(direction));
+        for (int direction = Left; direction <= Down; ++direction) {
+            // the player stands on one side and the box moves to the other
+            int playerCell = neighbours[direction];
+            int destination = neighbours[direction ^ 1];
+            if (playerCell != -1 && reachable.test(playerCell) && isValid(state, destination)
+                    && !deadSquares.test(destination)) {
+                if (!pushable.test(movable)) {
+                    ++pruned;
+                    continue;
+                }
+                // a box pushed into a tunnel keeps going until it is out
+                Direction push = Direction(direction ^ 1);
+                const Bitboard &tunnel = tunnelCells[push / 2];
+                int behind = movable;
+                int pushes = 1;
+                while (macroMoves && tunnel.test(behind) && tunnel.test(destination) && !goals.test(destination)) {
+                    int nextCell = neighbourOf(destination, push);
+                    if (!isValid(state, nextCell) || deadSquares.test(nextCell))
+                        break;
+                    behind = destination;
+                    destination = nextCell;
+                    ++pushes;
+                }
+                LevelState newState(*state);
+                newState.movables.reset(movable);
+                newState.player = behind;
+                newState.cost = state->cost + reach.distanceTo(playerCell) + pushes;
+                int room = goalRoomAt.at(destination);
+                if (macroMoves && room != -1 && !goalRooms.at(room).cells.test(behind))
+                    enterGoalRoom(goalRooms.at(room), state, movable, &destination, &newState);
+                newState.movables.set(destination);
+                newState.movablesKey ^= movableZobristKeys.at(movable) ^ movableZobristKeys.at(destination);
+                nextStates.append(newState);
+            }
+        }
+    }
+    return pruned;
+}
+
+/*
+ * The states a push could have led to the given state from: the player
+ * walks up to a box and steps back from it, pulling it along. This is what
+ * searching backwards from the goal uses. Boxes are only pulled onto cells
+ * some box of the initial state can be pushed to.
+ */
+void LevelFormat::previousStatesFor(LevelState *state, QVector<LevelState> &previousStates) const
+{
+    previousStates.clear();
+    PlayerReach reach;
+    getPlayerReach(state, &reach);
+    for (int movable = state->movables.first(); movable != -1; movable = state->movables.next(movable)) {
+        for (int direction = Left; direction <= Down; ++direction) {
+            // the player stands next to the box and backs away from it
+            int pulledTo = neighbourOf(movable, Direction(direction));
+            if (pulledTo == -1 || !reach.contains(pulledTo) || !startReachable.test(pulledTo))
+                continue;
+            int steppedTo = neighbourOf(pulledTo, Direction(direction));
+            if (!isValid(state, steppedTo))
+                continue;
+            LevelState previousState(*state);
+            previousState.movables.reset(movable);
+            previousState.movables.set(pulledTo);
+            previousState.movablesKey ^= movableZobristKeys.at(movable) ^ movableZobristKeys.at(pulledTo);
+            previousState.player = steppedTo;
+            previousState.cost = state->cost + reach.distanceTo(pulledTo) + 1;
+            previousStates.append(previousState);
+        }
+    }
+}
+
+/*
+ * Every box on a goal, with the player in each of the areas the goals
+ * split the rest of the level into. Any of them can end a solution.
+ */
+QVector<LevelState> LevelFormat::goalStates() const
+{
+    QVector<LevelState> states;
+    LevelState state;
+    state.movables = goals;
+    state.previousState = NodeArena::NoNode;
+    state.cost = 0;
+    state.movablesKey = 0;
+    for (int goal = goals.first(); goal != -1; goal = goals.next(goal))
+        state.movablesKey ^= movableZobristKeys.at(goal);
+    Bitboard covered = goals;
+    for (int cell = floor.first(); cell != -1; cell = floor.next(cell)) {
+        if (covered.test(cell))
+            continue;
+        state.player = cell;
+        PlayerReach reach;
+        getPlayerReach(&state, &reach);
+        covered |= reach.cells();
+        states.append(state);
+    }
+    return states;
 }
 
 /*
@@ -229,11 +865,7 @@ QSet<LevelState*> *LevelFormat::nextStatesFor(LevelState *state) const
  */
 bool LevelFormat::goalReached(LevelState *state) const
 {
-    for (QPoint movable : state->movables) {
-        if (!goals.contains(movable))
-            return false;
-    }
-    return true;
+    return (state->movables & ~goals).none();
 }
 
 /*
@@ -243,10 +875,8 @@ bool LevelFormat::goalReached(LevelState *state) const
  */
 bool LevelFormat::similarTo(LevelState *a, LevelState *b) const
 {
-    for (QPoint movable : a->movables) {
-        if (!b->movables.contains(movable))
-            return false;
-    }
+    if (a->movables != b->movables)
+        return false;
     int playerDistance = distanceForPlayerToMoveTo(a, b->player);
     return playerDistance != -1;
 }
@@ -259,94 +889,321 @@ bool LevelFormat::similarTo(LevelState *a, LevelState *b, int tolerance) const
 {
     if (tolerance < 0)
         return false;
-    for (QPoint movable : a->movables) {
-        if (!b->movables.contains(movable))
-            return false;
-    }
+    if (a->movables != b->movables)
+        return false;
     int playerDistance = distanceForPlayerToMoveTo(a, b->player);
     return playerDistance != -1 && playerDistance <= tolerance;
 }
 
 /*
- * Returns the sum of the manhattan distances from each box to its nearest
- * goal if the puzzle is solvable at this state, otherwise returns -1.
+ * Returns the smallest total number of pushes needed to move every box to
+ * a goal of its own if the puzzle is solvable at this state, otherwise
+ * returns -1.
  */
 int LevelFormat::getHeuristic(LevelState *state) const
 {
-    // Forbidden zones are zones where any box being present makes the
-    // puzzle unsolvable (e.g. a concave wall without a target)
-    for (QPoint movable : state->movables) {
-        if (forbiddenZones.contains(movable))
-            return -1;
-    }
+    PhaseTimer timer(PhaseTotals::Heuristic);
+    // Dead squares are cells from which a box can never reach a target,
+    // they include the forbidden zones (e.g. a concave wall without a
+    // target). nextStatesFor never pushes a box onto one, so this only
+    // matters for the initial state.
+    if ((state->movables & deadSquares).any())
+        return -1;
 
     // Limited zones are zones where a certain number of boxes being present
     // makes the puzzle unsolvable (e.g. a concave wall without some targets)
-    for (LimitedZone limitedZone : limitedZones) {
-        int movablesInZone = 0;
-        if (limitedZone.horizontal) {
-            for (int i = limitedZone.start; i < limitedZone.end; ++i) {
-                if (state->movables.contains(QPoint(limitedZone.line, i)))
-                    ++movablesInZone;
+    for (const LimitedZone &limitedZone : limitedZones) {
+        if ((state->movables & limitedZone.cells).count() > limitedZone.maxMovablesAllowed)
+            return -1;
+    }
+
+    // Check if boxes are arranged in a way that block each other, first
+    // against the deadlocks seen before, which is much cheaper
+    if (deadlockPatterns->matches(state->movables))
+        return -1;
+    Bitboard frozen;
+    if (blockExists(state, &frozen)) {
+        learnDeadlock(frozen);
+        return -1;
+    }
+
+    // The boxes are matched to their own goals, each push costs at least
+    // one move. A box that cannot get a goal of its own makes this -1.
+    MatchingCache &cache = matchingCacheFor(levelId, pushDistances.constData(), goals.count());
+    cache.child = cache.parent;
+    if (!cache.child.update(state->movables))
+        cache.child.solve(state->movables);
+    return cache.child.cost();
+}
+
+/*
+ * Determines the number of moves needed for the player in a given state to
+ * move to a given cell, returns -1 if impossible. The reachable area grows
+ * one step at a time until it takes in the cell.
+ */
+int LevelFormat::distanceForPlayerToMoveTo(LevelState *state, int destination) const
+{
+    if (destination == state->player)
+        return 0;
+    quint64 open[Bitboard::Words];
+    quint64 reached[Bitboard::Words];
+    quint64 frontier[Bitboard::Words];
+    for (int i = 0; i < usedWords; ++i) {
+        open[i] = floor.word(i) & ~state->movables.word(i);
+        reached[i] = frontier[i] = 0;
+    }
+    reached[state->player >> 6] = frontier[state->player >> 6] = quint64(1) << (state->player & 63);
+    for (int distance = 1; growReach(open, reached, frontier); ++distance) {
+        if ((frontier[destination >> 6] >> (destination & 63)) & 1)
+            return distance;
+    }
+    return -1;
+}
+
+/*
+ * Builds the canonical key of a state. The player is normalized to the
+ * top-left-most reachable cell so that states differing only in where the
+ * player stands inside the same region share a key.
+ */
+StateKey LevelFormat::keyFor(LevelState *state) const
+{
+    StateKey key;
+    key.movables = state->movables;
+    // only the area is needed, not the distances, so the steps are not kept
+    quint64 open[Bitboard::Words];
+    quint64 reached[Bitboard::Words];
+    quint64 frontier[Bitboard::Words];
+    for (int i = 0; i < usedWords; ++i) {
+        open[i] = floor.word(i) & ~state->movables.word(i);
+        reached[i] = frontier[i] = 0;
+    }
+    reached[state->player >> 6] = frontier[state->player >> 6] = quint64(1) << (state->player & 63);
+    while (growReach(open, reached, frontier)) {}
+    // cells are numbered row by row, so the top-left-most one is the lowest
+    key.player = -1;
+    for (int i = 0; key.player == -1; ++i) {
+        if (reached[i])
+            key.player = (i << 6) + qCountTrailingZeroBits(reached[i]);
+    }
+    key.zobristKey = state->movablesKey ^ playerZobristKeys.at(key.player);
+    return key;
+}
+
+/*
+ * Reconstructs the moves for a transition produced by nextStatesFor, or a
+ * pull from previousStatesFor played backwards: the player walks (found by
+ * BFS) to the cell behind the box that moved, then pushes it to its new
+ * cell, in a straight line unless it is a goal room macro.
+ */
+QString LevelFormat::movesBetween(LevelState *from, LevelState *to) const
+{
+    int oldCell = (from->movables & ~to->movables).first();
+    int newCell = (to->movables & ~from->movables).first();
+    if (oldCell == -1 || newCell == -1)
+        return QString();
+    return QString::fromLatin1(boxMoves(from, oldCell, newCell));
+}
+
+bool StateKey::operator==(const StateKey &other) const
+{
+    return zobristKey == other.zobristKey && player == other.player && movables == other.movables;
+}
+
+/*
+ * The player moves taking the box on from to the cell to, which is either
+ * a straight run of pushes or, if that is blocked, the cheapest way found
+ * by boxPathMoves. Empty if the box cannot get there.
+ */
+QByteArray LevelFormat::boxMoves(LevelState *state, int from, int to, int *player) const
+{
+    static const char pushLetters[] = "LRUD";
+    QPoint offset = pointAt(to) - pointAt(from);
+    if (offset.x() == 0 || offset.y() == 0) {
+        Direction direction = offset.x() < 0 ? Left : offset.x() > 0 ? Right : offset.y() < 0 ? Up : Down;
+        int pushFrom = neighbourOf(from, Direction(direction ^ 1));
+        bool clear = true;
+        for (int cell = from; clear && cell != to; cell = neighbourOf(cell, direction))
+            clear = isValid(state, neighbourOf(cell, direction));
+        QByteArray moves;
+        if (clear && walkMoves(state, state->player, pushFrom, &moves)) {
+            int behind = pushFrom;
+            for (int cell = from; cell != to; cell = neighbourOf(cell, direction)) {
+                moves.append(pushLetters[direction]);
+                behind = cell;
             }
+            if (player)
+                *player = behind;
+            return moves;
         }
-        else {
-            for (int i = limitedZone.start; i < limitedZone.end; ++i) {
-                if (state->movables.contains(QPoint(i, limitedZone.line)))
-                    ++movablesInZone;
+    }
+    return boxPathMoves(state, from, to, player);
+}
+
+/*
+ * Appends the letters of a shortest walk of the player between two cells
+ * around the boxes of the state, returns false if there is none.
+ */
+bool LevelFormat::walkMoves(LevelState *state, int from, int to, QByteArray *moves) const
+{
+    static const char walkLetters[] = "lrud";
+    // BFS remembering the direction each cell was entered by
+    int enteredBy[Bitboard::MaxCells];
+    int cellsQueue[Bitboard::MaxCells];
+    int head = 0;
+    int tail = 0;
+    Bitboard seen;
+    cellsQueue[tail++] = from;
+    seen.set(from);
+    while (head != tail && !seen.test(to)) {
+        int cell = cellsQueue[head++];
+        for (int nextDirection = Left; nextDirection <= Down; ++nextDirection) {
+            int nextCell = neighbourOf(cell, Direction(nextDirection));
+            if (isValid(state, nextCell) && !seen.test(nextCell)) {
+                seen.set(nextCell);
+                enteredBy[nextCell] = nextDirection;
+                cellsQueue[tail++] = nextCell;
             }
         }
-        if (movablesInZone > limitedZone.maxMovablesAllowed)
-            return -1;
     }
+    if (to == -1 || !seen.test(to))
+        return false;
+    QByteArray walk;
+    for (int cell = to; cell != from; cell = neighbourOf(cell, Direction(enteredBy[cell] ^ 1)))
+        walk.prepend(walkLetters[enteredBy[cell]]);
+    moves->append(walk);
+    return true;
+}
 
-    // Check if boxes are arranged in a way that block each other
-    if (blockExists(state))
-        return -1;
-
-    int sumOfDistances = 0;
-    for (QPoint movable : state->movables) {
-        int pathToClosestGoal = INT_MAX;
-        for (QPoint goal : goals)
-            pathToClosestGoal = qMin(pathToClosestGoal, (movable - goal).manhattanLength());
-        sumOfDistances += pathToClosestGoal;
-    }
-    return sumOfDistances;
-}
-
-/*
- * Uses BFS to determine the number of moves needed for the player in
- * a given state to move to a given position, returns -1 if impossible.
- */
-int LevelFormat::distanceForPlayerToMoveTo(LevelState *state, const QPoint &destination) const
-{
-    QSet<QPoint> seen;
-    QQueue<QPoint> pointsQueue;
-    QQueue<int> costsQueue;
-    pointsQueue.enqueue(state->player);
-    costsQueue.enqueue(0);
-    while (!pointsQueue.isEmpty()) {
-        QPoint point = pointsQueue.dequeue();
-        int cost = costsQueue.dequeue();
-        if (point == destination) {
-            return cost;
-        }
-        else if (!seen.contains(point)) {
-            seen.insert(point);
-            QList<QPoint> nextPoints;
-            nextPoints << QPoint(point.x() - 1, point.y());
-            nextPoints << QPoint(point.x() + 1, point.y());
-            nextPoints << QPoint(point.x(), point.y() - 1);
-            nextPoints << QPoint(point.x(), point.y() + 1);
-            for (QPoint nextPoint : nextPoints) {
-                if (isValid(state, nextPoint)) {
-                    pointsQueue.enqueue(nextPoint);
-                    costsQueue.enqueue(cost + 1);
-                }
+/*
+ * Finds the fewest moves taking a single box from one cell to another
+ * while the other boxes stay put, with Dijkstra's algorithm over the box's
+ * cell and the side of it the player is on. Pushing costs one move and
+ * going around the box to another side costs the length of the walk.
+ * Only used for macro moves, which are rare enough for the walks to be
+ * searched again at every step.
+ */
+QByteArray LevelFormat::boxPathMoves(LevelState *state, int from, int to, int *player) const
+{
+    static const char pushLetters[] = "LRUD";
+    typedef QPair<int, int> Entry; // (moves so far, cell * 4 + side)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    int distances[Bitboard::MaxCells * 4];
+    int previous[Bitboard::MaxCells * 4]; // -1 where the player walked from the start
+    for (int i = 0; i < height * width * 4; ++i)
+        distances[i] = INT_MAX;
+    LevelState around(*state);
+    PlayerReach walks;
+    getPlayerReach(&around, &walks);
+    for (int side = Left; side <= Down; ++side) {
+        int cell = neighbourOf(from, Direction(side));
+        if (cell != -1 && walks.contains(cell)) {
+            distances[from * 4 + side] = walks.distanceTo(cell);
+            previous[from * 4 + side] = -1;
+            queue.push(Entry(walks.distanceTo(cell), from * 4 + side));
+        }
+    }
+    around.movables.reset(from);
+    int last = -1;
+    while (!queue.empty()) {
+        int distance = queue.top().first;
+        int position = queue.top().second;
+        queue.pop();
+        if (distance > distances[position])
+            continue;
+        int movable = position / 4;
+        int side = position % 4;
+        if (movable == to) {
+            last = position;
+            break;
+        }
+        int pushedTo = neighbourOf(movable, Direction(side ^ 1));
+        if (isValid(&around, pushedTo) && !deadSquares.test(pushedTo) && distance + 1 < distances[pushedTo * 4 + side]) {
+            distances[pushedTo * 4 + side] = distance + 1;
+            previous[pushedTo * 4 + side] = position;
+            queue.push(Entry(distance + 1, pushedTo * 4 + side));
+        }
+        around.movables.set(movable);
+        around.player = neighbourOf(movable, Direction(side));
+        getPlayerReach(&around, &walks);
+        around.movables.reset(movable);
+        for (int otherSide = Left; otherSide <= Down; ++otherSide) {
+            int cell = neighbourOf(movable, Direction(otherSide));
+            if (otherSide == side || cell == -1 || !walks.contains(cell))
+                continue;
+            int walk = walks.distanceTo(cell);
+            if (distance + walk < distances[movable * 4 + otherSide]) {
+                distances[movable * 4 + otherSide] = distance + walk;
+                previous[movable * 4 + otherSide] = position;
+                queue.push(Entry(distance + walk, movable * 4 + otherSide));
             }
         }
     }
-    return -1;
+    if (last == -1)
+        return QByteArray();
+
+    QVector<int> path;
+    for (int position = last; position != -1; position = previous[position])
+        path.prepend(position);
+    QByteArray moves;
+    around.player = state->player;
+    for (int i = 0; i < path.size(); ++i) {
+        int movable = path.at(i) / 4;
+        int side = path.at(i) % 4;
+        if (i > 0 && path.at(i - 1) / 4 != movable) {
+            moves.append(pushLetters[side ^ 1]);
+        } else {
+            around.movables.set(movable);
+            walkMoves(&around, around.player, neighbourOf(movable, Direction(side)), &moves);
+            around.movables.reset(movable);
+        }
+        around.player = neighbourOf(movable, Direction(side));
+    }
+    if (player)
+        *player = around.player;
+    return moves;
+}
+
+/*
+ * Takes a box that was just pushed onto the entrance of a goal room on to
+ * the deepest free goal of the room, if every box already in the room is
+ * on a goal and the way there is free. The box is at *destination in
+ * newState's cost and player position, and both are updated if it moves.
+ */
+void LevelFormat::enterGoalRoom(const GoalRoom &room, LevelState *state, int movable, int *destination,
+                                LevelState *newState) const
+{
+    if ((state->movables & room.cells & ~goals).any())
+        return;
+    int target = -1;
+    for (int goal : room.fillOrder) {
+        if (!state->movables.test(goal)) {
+            target = goal;
+            break;
+        }
+    }
+    if (target == -1)
+        return;
+    int player;
+    QByteArray moves = boxMoves(state, movable, target, &player);
+    if (moves.isEmpty())
+        return;
+    *destination = target;
+    newState->player = player;
+    newState->cost = state->cost + moves.size();
+}
+
+/*
+ * Converts between level coordinates and the linearized cell index
+ * used by states and bitboards.
+ */
+int LevelFormat::cellAt(const QPoint &pos) const
+{
+    return pos.y() * width + pos.x();
+}
+
+QPoint LevelFormat::pointAt(int cell) const
+{
+    return QPoint(cell % width, cell / width);
 }
 
 /*
@@ -357,17 +1214,17 @@ void LevelFormat::log(LevelState *state) const
     for (int i = 0; i < width; i++) {
         QString row;
         for (int j = 0; j < height; j++) {
-            QPoint pos(i, j);
-            if (walls.contains(pos))
+            int cell = cellAt(QPoint(i, j));
+            if (walls.test(cell))
                 row += "X";
-            else if (state->player == pos)
+            else if (state->player == cell)
                 row += "P";
-            else if (state->movables.contains(pos)) {
-                if (goals.contains(pos))
+            else if (state->movables.test(cell)) {
+                if (goals.test(cell))
                     row += "#";
                 else
                     row += "+";
-            } else if (goals.contains(pos))
+            } else if (goals.test(cell))
                 row += "O";
             else
                 row += " ";
@@ -377,35 +1234,146 @@ void LevelFormat::log(LevelState *state) const
 }
 
 /*
- * Uses BFS to return a set of points the player can access in a given
- * state, as well as their costs.
- */
-QHash<QPoint, int> *LevelFormat::getReachablePointsWithCosts(LevelState *state) const
-{
-    QHash<QPoint, int> *hash = new QHash<QPoint, int>;
-    QQueue<QPoint> pointsQueue;
-    QQueue<int> costsQueue;
-    pointsQueue.enqueue(state->player);
-    costsQueue.enqueue(0);
-    while (!pointsQueue.isEmpty()) {
-        QPoint point = pointsQueue.dequeue();
-        int cost = costsQueue.dequeue();
-        if (!hash->contains(point)) {
-            hash->insert(point, cost);
-            QList<QPoint> nextPoints;
-            nextPoints << QPoint(point.x() - 1, point.y());
-            nextPoints << QPoint(point.x() + 1, point.y());
-            nextPoints << QPoint(point.x(), point.y() - 1);
-            nextPoints << QPoint(point.x(), point.y() + 1);
-            for (QPoint nextPoint : nextPoints) {
-                if (isValid(state, nextPoint)) {
-                    pointsQueue.enqueue(nextPoint);
-                    costsQueue.enqueue(cost + 1);
+ * Finds the cells the player can get to in a given state by flood filling
+ * the free cells from the player's, a whole step of cells at a time.
+ */
+void LevelFormat::getPlayerReach(LevelState *state, PlayerReach *reach) const
+{
+    quint64 open[Bitboard::Words];
+    quint64 reached[Bitboard::Words];
+    quint64 frontier[Bitboard::Words];
+    for (int i = 0; i < usedWords; ++i) {
+        open[i] = floor.word(i) & ~state->movables.word(i);
+        reached[i] = frontier[i] = 0;
+    }
+    reached[state->player >> 6] = frontier[state->player >> 6] = quint64(1) << (state->player & 63);
+    reach->steps.clear();
+    do {
+        Bitboard step;
+        for (int i = 0; i < usedWords; ++i)
+            step.setWord(i, reached[i]);
+        reach->steps.append(step);
+    } while (growReach(open, reached, frontier));
+}
+
+/*
+ * Shifting by one moves a cell sideways and shifting by the row width
+ * moves it a row up or down. Only cells with a neighbour that way are
+ * shifted, so nothing wraps around into the next row. Only the words the
+ * level covers are touched, and the loops are simple enough for the
+ * compiler to vectorise.
+ */
+bool LevelFormat::growReach(const quint64 *open, quint64 *reached, quint64 *frontier) const
+{
+    quint64 left[Bitboard::Words + 1];
+    quint64 right[Bitboard::Words + 1];
+    quint64 up[Bitboard::Words];
+    quint64 down[Bitboard::Words];
+    for (int i = 0; i < usedWords; ++i) {
+        left[i] = frontier[i] & stepSources[Left][i];
+        right[i + 1] = frontier[i] & stepSources[Right][i];
+        up[i] = frontier[i] & stepSources[Up][i];
+        down[i] = frontier[i] & stepSources[Down][i];
+    }
+    left[usedWords] = 0;
+    right[0] = 0;
+    int wordShift = width >> 6;
+    int bitShift = width & 63;
+    quint64 any = 0;
+    for (int i = 0; i < usedWords; ++i) {
+        quint64 grown = (left[i] >> 1) | (left[i + 1] << 63) | (right[i + 1] << 1) | (right[i] >> 63);
+        // a row up is width cells lower, a row down width cells higher
+        if (i + wordShift < usedWords) {
+            grown |= up[i + wordShift] >> bitShift;
+            if (bitShift && i + wordShift + 1 < usedWords)
+                grown |= up[i + wordShift + 1] << (64 - bitShift);
+        }
+        if (i >= wordShift) {
+            grown |= down[i - wordShift] << bitShift;
+            if (bitShift && i > wordShift)
+                grown |= down[i - wordShift - 1] >> (64 - bitShift);
+        }
+        frontier[i] = grown & open[i] & ~reached[i];
+        reached[i] |= frontier[i];
+        any |= frontier[i];
+    }
+    return any != 0;
+}
+
+/*
+ * A corral is an area of empty cells the player cannot reach, fenced in by
+ * walls and boxes. It is a PI-corral if every push of a fence box that
+ * could ever be made from outside the area goes into it and can be made
+ * right now. A corral with an empty goal or a fence box off its goal
+ * needs one of those pushes sooner or later, and since the boxes outside
+ * cannot interfere with them, making one first loses nothing: the pushes
+ * of other boxes stay possible afterwards and the solution stays as many
+ * pushes long, although it may take more player moves.
+ *
+ * If the state has unsolved PI-corrals, sets fence to the boxes fencing in
+ * the one with the fewest and returns true. Pushes of other boxes need not
+ * be tried, and if the fence cannot be pushed at all the state is dead.
+ */
+bool LevelFormat::findPICorral(LevelState *state, const Bitboard &reachable, Bitboard *fence) const
+{
+    Bitboard unexplored = floor & ~reachable & ~state->movables;
+    int fewestFenceBoxes = INT_MAX;
+    int cellsStack[Bitboard::MaxCells];
+    while (unexplored.any()) {
+        Bitboard corral;
+        Bitboard corralFence;
+        int top = 0;
+        cellsStack[top++] = unexplored.first();
+        corral.set(cellsStack[0]);
+        unexplored.reset(cellsStack[0]);
+        while (top) {
+            int cell = cellsStack[--top];
+            for (int direction = Left; direction <= Down; ++direction) {
+                int nextCell = neighbourOf(cell, Direction(direction));
+                if (nextCell == -1) {
+                    continue;
+                } else if (state->movables.test(nextCell)) {
+                    corralFence.set(nextCell);
+                } else if (unexplored.test(nextCell)) {
+                    unexplored.reset(nextCell);
+                    corral.set(nextCell);
+                    cellsStack[top++] = nextCell;
+                }
+            }
+        }
+
+        int fenceBoxes = corralFence.count();
+        if (fenceBoxes >= fewestFenceBoxes || ((corral & goals).none() && (corralFence & ~goals).none()))
+            continue;
+        bool piCorral = true;
+        for (int movable = corralFence.first(); movable != -1 && piCorral; movable = corralFence.next(movable)) {
+            for (int direction = Left; direction <= Down; ++direction) {
+                int playerCell = neighbourOf(movable, Direction(direction));
+                int destination = neighbourOf(movable, Direction(direction ^ 1));
+                if (playerCell == -1 || destination == -1 || corral.test(playerCell) || corralFence.test(playerCell)
+                        || corralFence.test(destination) || deadSquares.test(destination))
+                    continue;
+                if (!corral.test(destination) || !reachable.test(playerCell)) {
+                    piCorral = false;
+                    break;
                 }
             }
         }
+        if (piCorral) {
+            *fence = corralFence;
+            fewestFenceBoxes = fenceBoxes;
+        }
     }
-    return hash;
+    return fewestFenceBoxes != INT_MAX;
+}
+
+/*
+ * Returns the cell next to the given one in the given direction, or -1
+ * if that would leave the domain of the level or end up in a wall.
+ */
+int LevelFormat::neighbourOf(int cell, Direction direction) const
+{
+    return neighbours.at(cell * 4 + direction);
 }
 
 /*
@@ -414,15 +1382,15 @@ QHash<QPoint, int> *LevelFormat::getReachablePointsWithCosts(LevelState *state)
 bool LevelFormat::isValid(const QPoint &pos) const
 {
     return pos.x() >= 0 && pos.x() < width && pos.y() >= 0 && pos.y() < height &&
-            !walls.contains(pos);
+            !walls.test(cellAt(pos));
 }
 
 /*
- * Same as above but also checks if there is a box at pos.
+ * Same as above but for cells, and also checks if there is a box there.
  */
-bool LevelFormat::isValid(LevelState *state, const QPoint &pos) const
+bool LevelFormat::isValid(LevelState *state, int cell) const
 {
-    return isValid(pos) && !state->movables.contains(pos);
+    return cell != -1 && !state->movables.test(cell);
 }
 
 /*
@@ -456,64 +1424,53 @@ bool LevelFormat::isValid(LevelState *state, const QPoint &pos) const
  * return true, otherwise return false
  *
  */
-bool LevelFormat::blockExists(LevelState *state) const
+bool LevelFormat::blockExists(LevelState *state, Bitboard *frozen) const
 {
-    // in the blockedMovables hash, int is a number from 0 to 15
-    // flagging which adjacent positions are blocked
+    PhaseTimer timer(PhaseTotals::Deadlock);
+    // in the blockCodes array, indexed by the cell of a box, each entry
+    // is a number from 0 to 15 flagging which adjacent positions are blocked
     // 0b0001 - left side blocked
     // 0b0010 - right side blocked
     // 0b0100 - up side blocked
     // 0b1000 - down side blocked
-    QHash<QPoint, qint8> blockedMovables;
-    for (QPoint movable : state->movables) {
+    qint8 blockCodes[Bitboard::MaxCells];
+    int queue[Bitboard::MaxCells];
+    int head = 0;
+    int tail = 0;
+    Bitboard queued;
+    for (int movable = state->movables.first(); movable != -1; movable = state->movables.next(movable)) {
         qint8 blockCode = 0;
-        if (!isValid(state, QPoint(movable.x() - 1, movable.y())))
-            blockCode |= 1;
-        if (!isValid(state, QPoint(movable.x() + 1, movable.y())))
-            blockCode |= 2;
-        if (!isValid(state, QPoint(movable.x(), movable.y() - 1)))
-            blockCode |= 4;
-        if (!isValid(state, QPoint(movable.x(), movable.y() + 1)))
-            blockCode |= 8;
-        blockedMovables.insert(movable, blockCode);
-    }
-
-    QQueue<QPoint> queue;
-    QSet<QPoint> movableLater;
-    for (QPoint movable : blockedMovables.keys()) {
-        if (!blockExistsForCode(blockedMovables.value(movable)))
-            queue.enqueue(movable);
-    }
-    while (!queue.isEmpty()) {
-        QPoint movable = queue.dequeue();
-        movableLater.insert(movable);
-        QPoint leftPoint = QPoint(movable.x() - 1, movable.y());
-        QPoint rightPoint = QPoint(movable.x() + 1, movable.y());
-        QPoint upPoint = QPoint(movable.x(), movable.y() - 1);
-        QPoint downPoint = QPoint(movable.x(), movable.y() + 1);
-        if (blockedMovables.contains(leftPoint) && !movableLater.contains(leftPoint) &&
-                blockExistsForCode(blockedMovables.value(leftPoint)) &&
-                !blockExistsForCode(blockedMovables.value(leftPoint) & ~2))
-            queue.enqueue(leftPoint);
-        if (blockedMovables.contains(rightPoint) && !movableLater.contains(rightPoint) &&
-                blockExistsForCode(blockedMovables.value(rightPoint)) &&
-                !blockExistsForCode(blockedMovables.value(rightPoint) & ~1))
-            queue.enqueue(rightPoint);
-        if (blockedMovables.contains(upPoint) && !movableLater.contains(upPoint) &&
-                blockExistsForCode(blockedMovables.value(upPoint)) &&
-                !blockExistsForCode(blockedMovables.value(upPoint) & ~8))
-            queue.enqueue(upPoint);
-        if (blockedMovables.contains(downPoint) && !movableLater.contains(downPoint) &&
-                blockExistsForCode(blockedMovables.value(downPoint)) &&
-                !blockExistsForCode(blockedMovables.value(downPoint) & ~4))
-            queue.enqueue(downPoint);
-    }
-
-    for (QPoint movable : blockedMovables.keys()) {
-        if (!movableLater.contains(movable) && !goals.contains(movable))
-            return true;
-    }
-    return false;
+        for (int direction = Left; direction <= Down; ++direction) {
+            if (!isValid(state, neighbourOf(movable, Direction(direction))))
+                blockCode |= 1 << direction;
+        }
+        blockCodes[movable] = blockCode;
+        if (!blockExistsForCode(blockCode)) {
+            queue[tail++] = movable;
+            queued.set(movable);
+        }
+    }
+
+    Bitboard movableLater;
+    while (head != tail) {
+        int movable = queue[head++];
+        movableLater.set(movable);
+        for (int direction = Left; direction <= Down; ++direction) {
+            // the side of the neighbour facing this box is the opposite direction
+            int neighbour = neighbourOf(movable, Direction(direction));
+            int facingSide = 1 << (direction ^ 1);
+            if (neighbour != -1 && state->movables.test(neighbour) && !queued.test(neighbour) &&
+                    blockExistsForCode(blockCodes[neighbour]) &&
+                    !blockExistsForCode(blockCodes[neighbour] & ~facingSide)) {
+                queue[tail++] = neighbour;
+                queued.set(neighbour);
+            }
+        }
+    }
+
+    if (frozen)
+        *frozen = state->movables & ~movableLater;
+    return (state->movables & ~movableLater & ~goals).any();
 }
 
 /*
@@ -1,19 +1,63 @@
 #ifndef LEVELFORMAT_H
 #define LEVELFORMAT_H
 
-#include "levelitem.h"
+#include "bitboard.h"
 
 #include <QLinkedList>
+#include <QList>
 #include <QSet>
+#include <QVarLengthArray>
+#include <QVector>
 
+class DeadlockPatterns;
+class QByteArray;
 class QPoint;
+class QString;
 
+/*
+ * Cells are referred to by their linearized index (row * width + column),
+ * see LevelFormat::cellAt and LevelFormat::pointAt.
+ */
 struct LevelState
 {
-    QSet<QPoint> movables;
-    QPoint player;
-    LevelState *previousState;
+    Bitboard movables;
+    int player;
+    quint32 previousState; // index in the solver's NodeArena
     int cost;
+    quint64 movablesKey; // Zobrist key of the box configuration
+};
+
+/*
+ * Canonical form of a state used for duplicate detection: the box positions
+ * in row-major order and the top-left-most cell the player can reach without
+ * pushing anything. Two states have equal keys exactly when the non-cost-based
+ * solvers consider them the same. The Zobrist key combines both parts and is
+ * what the key hashes on; the rest is only compared to rule out collisions.
+ */
+struct StateKey
+{
+    Bitboard movables;
+    int player;
+    quint64 zobristKey;
+
+    bool operator==(const StateKey &other) const;
+};
+
+/*
+ * The cells the player can walk to without pushing anything, found by
+ * growing the player's cell one step at a time with bitboard shifts. The
+ * area after every step is kept, so the walking distance to a cell is only
+ * worked out when it is asked for, by a binary search over the steps.
+ */
+class PlayerReach
+{
+public:
+    const Bitboard &cells() const; // all of them
+    bool contains(int cell) const;
+    int distanceTo(int cell) const; // -1 if unreachable
+private:
+    friend class LevelFormat;
+    QVarLengthArray<Bitboard, 64> steps; // the cells within each number of moves
 };
 
 struct LimitedZone
@@ -23,56 +67,167 @@ struct LimitedZone
     int end;
     bool horizontal;
     int maxMovablesAllowed;
+    Bitboard cells;
+};
+
+struct GoalRoom
+{
+    int entrance;
+    Bitboard cells;
+    QVector<int> fillOrder; // goals, deepest first
 };
 
 /*
- * The layout of a level is stored as a set of points representing the walls
- * and a set of points representing the targets. Forbidden zones are areas
+ * The layout of a level is stored as a bitboard of the walls and a bitboard
+ * of the targets, both indexed by cell. Forbidden zones are areas
  * such that if any box occupies that area, the puzzle is unsolvable. Limited
  * zones are regions such that if a certain number of boxes are in that region,
- * the puzzle is unsolvable (e.g. multiple targets along a wall). Level states
+ * the puzzle is unsolvable (e.g. multiple targets along a wall). Dead squares
+ * are the cells from which a single box cannot reach any target. Small groups
+ * of boxes that freeze each other are kept as deadlock patterns, precomputed
+ * for up to MaxPrecomputedBoxes boxes and learned during the search for
+ * larger ones, so that states containing them are rejected by a lookup
+ * instead of by blockExists. Level states
  * describe the positions of the players and boxes in a state, and should only
- * be used with the level layouts they were generated from. LevelFormat is not
- * responsible for deleting the states it generates.
+ * be used with the level layouts they were generated from. Generated states
+ * are handed out by value; storing them is up to the solvers.
  */
 
 class LevelFormat
 {
 public:
+    enum Tile { Player, Wall, Movable, MovableOnGoal, Goal };
+
     LevelFormat(int h, int w);
-    void setRoleAt(QPoint pos, LevelItem::Role role);
-    void buildZones(); // only use after all walls have been set
+    ~LevelFormat();
+    // parses XSB rows, returns nullptr and sets error if the level is unusable
+    static LevelFormat *fromRows(const QList<QByteArray> &rows, QString *error = nullptr);
+    void setTileAt(QPoint pos, Tile tile);
+    void buildZones(); // only use after all walls have been set, also builds the cell graph
     LevelState *getInitialState() const;
+    // macro moves and PI-corral pruning (see nextStatesFor) are on by
+    // default; solvers that must find the fewest moves turn them off
+    void setMacroMoves(bool enabled);
+    void setCorralPruning(bool enabled);
 
-    QSet<LevelState*> *nextStatesFor(LevelState *state) const;
+    // replaces contents, returns the number of pushes left out by corral pruning
+    int nextStatesFor(LevelState *state, QVector<LevelState> &nextStates) const;
+    // replaces contents with the states one push before this one
+    void previousStatesFor(LevelState *state, QVector<LevelState> &previousStates) const;
+    QVector<LevelState> goalStates() const;
     bool goalReached(LevelState *state) const;
     bool similarTo(LevelState *a, LevelState *b) const;
     bool similarTo(LevelState *a, LevelState *b, int tolerance) const;
     int getHeuristic(LevelState *state) const; // -1 if unsolvable
-    int distanceForPlayerToMoveTo(LevelState *state, const QPoint &destination) const;
+    int distanceForPlayerToMoveTo(LevelState *state, int destination) const;
+    StateKey keyFor(LevelState *state) const;
+    // player moves in LURD notation (lowercase walks, uppercase pushes)
+    // leading from one state to a successor of it
+    QString movesBetween(LevelState *from, LevelState *to) const;
+
+    int cellAt(const QPoint &pos) const;
+    QPoint pointAt(int cell) const;
 
     void log(LevelState *state) const;
 private:
-    QHash<QPoint, int> *getReachablePointsWithCosts(LevelState *state) const;
+    friend class LevelProbe; // times the private primitives in the microbenchmark
+
+    enum Direction { Left, Right, Up, Down };
+
+    static const int MaxPrecomputedBoxes = 4;
+    static const int MaxLearnedBoxes = 8;
+
+    void buildCellGraph();
+    void buildZobristKeys();
+    QVector<qint8> sideAreas() const;
+    void buildPushDistances();
+    void buildDeadSquares();
+    void buildDeadlockPatterns();
+    void buildMacroCells();
+    void buildStartReachableCells();
+    bool canFill(const GoalRoom &room) const;
+    void learnDeadlock(const Bitboard &frozen) const;
+    void getPlayerReach(LevelState *state, PlayerReach *reach) const;
+    // takes the cells next to the frontier that are open and not reached
+    // yet as the new frontier and adds them to reached, false if none are
+    bool growReach(const quint64 *open, quint64 *reached, quint64 *frontier) const;
+    bool findPICorral(LevelState *state, const Bitboard &reachable, Bitboard *fence) const;
+    // moves taking one box from a cell to another, empty if impossible;
+    // player is set to where the player ends up
+    QByteArray boxMoves(LevelState *state, int from, int to, int *player = nullptr) const;
+    QByteArray boxPathMoves(LevelState *state, int from, int to, int *player) const;
+    bool walkMoves(LevelState *state, int from, int to, QByteArray *moves) const;
+    void enterGoalRoom(const GoalRoom &room, LevelState *state, int movable, int *destination,
+                       LevelState *newState) const;
+    int neighbourOf(int cell, Direction direction) const; // -1 if out of domain or wall
     bool isValid(const QPoint &pos) const; // in domain and not at wall
-    bool isValid(LevelState *state, const QPoint &pos) const; // also not at a box
-    bool blockExists(LevelState *state) const; // if blocks are stuck somewhere
+    bool isValid(LevelState *state, int cell) const; // also not at a box, -1 is never valid
+    // if blocks are stuck somewhere, frozen is set to the boxes that can never move
+    bool blockExists(LevelState *state, Bitboard *frozen = nullptr) const;
     bool blockExistsForCode(int code) const; // helper, see implementation for explanation
 
-    QSet<QPoint> goals;
-    QSet<QPoint> walls;
+    Bitboard goals;
+    Bitboard walls;
     LevelState *initialState;
 
     QList<LimitedZone> limitedZones;
-    QSet<QPoint> forbiddenZones;
+    Bitboard forbiddenZones;
+    // pushes from each cell to each goal, a row of goals.count() entries per
+    // cell, BoxMatching::Unreachable if the goal cannot be reached
+    QVector<quint16> pushDistances;
+    int levelId; // changes whenever the push distances are rebuilt
+    Bitboard deadSquares; // cells a box can never be pushed to a goal from
+    DeadlockPatterns *deadlockPatterns; // kept across solves of this level
+    Bitboard tunnelCells[2]; // by axis of the push, Left / 2 or Up / 2
+    QList<GoalRoom> goalRooms;
+    QVector<int> goalRoomAt; // room entered through each cell, -1 if none
+    bool macroMoves;
+    bool corralPruning;
+    Bitboard startReachable; // cells the initial boxes can be pushed to
+
+    // static cell graph, four entries per cell in Direction order
+    QVector<int> neighbours;
+    Bitboard floor;
+    quint64 stepSources[4][Bitboard::Words]; // by Direction, the cells with a neighbour that way
+    int usedWords; // of a bitboard, the rest are beyond the level
+
+    // random keys per cell, XORed together to hash box and player positions
+    QVector<quint64> movableZobristKeys;
+    QVector<quint64> playerZobristKeys;
 
     int height;
     int width;
 };
 
-inline uint qHash (const QPoint &key)
+inline const Bitboard &PlayerReach::cells() const
+{
+    return steps.last();
+}
+
+inline bool PlayerReach::contains(int cell) const
+{
+    return steps.last().test(cell);
+}
+
+inline int PlayerReach::distanceTo(int cell) const
+{
+    if (!contains(cell))
+        return -1;
+    int low = 0;
+    int high = steps.size() - 1;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (steps.at(middle).test(cell))
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+inline uint qHash (const StateKey &key)
 {
-    return qHash (QPair<int,int>(key.x(), key.y()));
+    return uint(key.zobristKey ^ (key.zobristKey >> 32));
 }
 
 #endif // LEVELFORMAT_H
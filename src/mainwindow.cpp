@@ -1,17 +1,26 @@
 #include "mainwindow.h"
 #include "algorithmdialog.h"
+#include "anytimeastarsolver.h"
 #include "astarsolver.h"
 #include "bfssolver.h"
+#include "bidirectionalsolver.h"
 #include "dfssolver.h"
+#include "externalastarsolver.h"
+#include "hdastarsolver.h"
+#include "idastarsolver.h"
 #include "lcfssolver.h"
 #include "leveleditor.h"
 #include "levelformat.h"
+#include "phasecounters.h"
+#include "solverthread.h"
 
 #include <QtWidgets>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     solver(nullptr),
+    solverThread(nullptr),
+    solveRunId(0),
     algorithm(AStar)
 {
     editorScene = new LevelEditor(32, 16, this);
@@ -19,7 +28,7 @@ MainWindow::MainWindow(QWidget *parent) :
     view->setAlignment(Qt::AlignTop | Qt::AlignLeft);
 
     connect(editorScene, &LevelEditor::solveInterrupted,
-            this, [this]() { navigateGroup->setEnabled(false); });
+            this, &MainWindow::solveInterrupted);
 
     createActions();
     createGroupBoxes();
@@ -41,8 +50,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
-    if (solver)
-        delete solver;
+    stopSolving();
 }
 
 void MainWindow::createActions()
@@ -71,6 +79,9 @@ void MainWindow::createActions()
     solveAction = new QAction(tr("Solve"));
     connect(solveAction, SIGNAL(triggered()),
             this, SLOT(solveRequested()));
+    cancelSolveAction = new QAction(tr("Cancel"));
+    connect(cancelSolveAction, SIGNAL(triggered()),
+            this, SLOT(cancelSolveRequested()));
     solveOptionsAction = new QAction(tr("Solve Options"));
     connect(solveOptionsAction, SIGNAL(triggered()),
             this, SLOT(solveOptionsRequested()));
@@ -126,14 +137,19 @@ void MainWindow::createGroupBoxes()
     tileEditGroup->setLayout(tileLayout);
 
     solveGroup = new QGroupBox(tr("Solve"));
-    QPushButton *solveButton = new QPushButton(tr("Solve!"));
+    solveButton = new QPushButton(tr("Solve!"));
     connect(solveButton, SIGNAL(released()),
             this, SLOT(solveRequested()));
+    cancelSolveButton = new QPushButton(tr("Cancel"));
+    connect(cancelSolveButton, SIGNAL(released()),
+            cancelSolveAction, SLOT(trigger()));
+    cancelSolveButton->setEnabled(false);
     QPushButton *solveOptionsButton = new QPushButton(tr("Solve Options"));
     connect(solveOptionsButton, SIGNAL(released()),
             this, SLOT(solveOptionsRequested()));
     QVBoxLayout *solveLayout = new QVBoxLayout;
     solveLayout->addWidget(solveButton);
+    solveLayout->addWidget(cancelSolveButton);
     solveLayout->addWidget(solveOptionsButton);
     solveGroup->setLayout(solveLayout);
 
@@ -162,7 +178,6 @@ void MainWindow::createGroupBoxes()
 void MainWindow::roleChanged(LevelItem::Role role)
 {
     editorScene->setRole(role);
-    navigateGroup->setEnabled(false);
 }
 
 void MainWindow::clearRequested()
@@ -172,45 +187,157 @@ void MainWindow::clearRequested()
 
 void MainWindow::solveRequested()
 {
-    if (solver) {
-        delete solver;
-        solver = nullptr;
-    }
+    stopSolving();
+    navigateGroup->setEnabled(false);
     LevelFormat *format = editorScene->getLevelFormat();
+    if (!format) {
+        QMessageBox messageBox;
+        messageBox.setStandardButtons(QMessageBox::Ok);
+        messageBox.setText(tr("Invalid level. Please make sure exactly one player exists and there are exactly as many targets as there are boxes"));
+        messageBox.exec();
+        return;
+    }
+    switch (algorithm) {
+    case DFS:
+        solver = new DFSSolver(format);
+        break;
+    case BFS:
+        solver = new BFSSolver(format);
+        break;
+    case LCFS:
+        solver = new LCFSSolver(format);
+        break;
+    case AStar:
+        solver = new AStarSolver(format);
+        break;
+    case ParallelAStar:
+        solver = new HDAStarSolver(format);
+        break;
+    case IDAStar:
+        solver = new IDAStarSolver(format);
+        break;
+    case Bidirectional:
+        solver = new BidirectionalSolver(format);
+        break;
+    case AnytimeAStar:
+        solver = new AnytimeAStarSolver(format);
+        break;
+    case ExternalAStar:
+        solver = new ExternalAStarSolver(format);
+    }
+    bestSolution.clear();
+    solverThread = new SolverThread(solver, ++solveRunId, this);
+    connect(solverThread, &SolverThread::progressed,
+            this, &MainWindow::solveProgressed);
+    connect(solverThread, &SolverThread::solutionImproved,
+            this, &MainWindow::solutionImproved);
+    connect(solverThread, &SolverThread::solveFinished,
+            this, &MainWindow::solveFinished);
+    solveButton->setEnabled(false);
+    cancelSolveButton->setEnabled(true);
+    statusBar()->showMessage(tr("Solving..."));
+    solverThread->start();
+}
+
+void MainWindow::cancelSolveRequested()
+{
+    if (solverThread)
+        solver->cancel(); // solveFinished() follows once the search notices
+}
+
+void MainWindow::solveProgressed(int runId, qint64 nodesExpanded, int frontierSize, double nodesPerSecond, int bestFValue)
+{
+    if (runId != solveRunId)
+        return;
+    QString message = tr("Expanded %1 states, %2 in frontier, %3 states/s")
+            .arg(nodesExpanded).arg(frontierSize).arg(qRound(nodesPerSecond));
+    if (bestFValue != -1)
+        message += tr(", best f-value %1").arg(bestFValue);
+    if (!bestSolution.isEmpty())
+        message += ", " + bestSolution;
+    statusBar()->showMessage(message);
+}
+
+void MainWindow::solutionImproved(int runId, int cost, int lowerBound)
+{
+    if (runId != solveRunId)
+        return;
+    bestSolution = tr("best solution %1 moves (optimum at least %2)").arg(cost).arg(lowerBound);
+    statusBar()->showMessage(bestSolution);
+}
+
+void MainWindow::solveFinished(int runId, bool solved)
+{
+    if (runId != solveRunId)
+        return; // a solve that stopSolving() already cleaned up
+    solverThread->wait();
+    delete solverThread;
+    solverThread = nullptr;
+    solveButton->setEnabled(true);
+    cancelSolveButton->setEnabled(false);
+    statusBar()->clearMessage();
+
     QMessageBox messageBox;
     messageBox.setStandardButtons(QMessageBox::Ok);
-    if (format) {
-        switch (algorithm) {
-        case DFS:
-            solver = new DFSSolver(format);
-            break;
-        case BFS:
-            solver = new BFSSolver(format);
-            break;
-        case LCFS:
-            solver = new LCFSSolver(format);
-            break;
-        case AStar:
-            solver = new AStarSolver(format);
-        }
-        bool solved = solver->isSolved();
-        if (solved) {
+    if (solved) {
+        if (bestSolution.isEmpty())
             messageBox.setText(tr("Solution found!"));
-            navigateGroup->setEnabled(true);
-        } else {
-            messageBox.setText(tr("Solution not found because puzzle is impossible!"));
-        }
+        else
+            messageBox.setText(tr("Solution found, %1.").arg(bestSolution));
+        navigateGroup->setEnabled(true);
+    } else if (solver->isCancelled()) {
+        messageBox.setText(tr("Solve cancelled."));
     } else {
-        messageBox.setText(tr("Invalid level. Please make sure exactly one player exists and there are exactly as many targets as there are boxes"));
+        messageBox.setText(tr("Solution not found because puzzle is impossible!"));
+    }
+    SolveStatistics statistics = solver->statistics();
+    if (statistics.phases.any()) {
+        QString details;
+        for (int phase = 0; phase < PhaseTotals::PhaseCount; ++phase) {
+            qint64 calls = statistics.phases.calls[phase];
+            qint64 nanoseconds = statistics.phases.nanoseconds[phase];
+            details += tr("%1: %2 calls, %3 ms, %4 ns per call\n").arg(PhaseTotals::name(phase))
+                    .arg(calls).arg(nanoseconds / 1000000).arg(calls ? nanoseconds / calls : 0);
+        }
+        messageBox.setDetailedText(details);
     }
     messageBox.exec();
 }
 
+/*
+ * The level editor is about to delete the level format the solver works
+ * on, so the solve has to be stopped first.
+ */
+void MainWindow::solveInterrupted()
+{
+    stopSolving();
+    navigateGroup->setEnabled(false);
+}
+
+void MainWindow::stopSolving()
+{
+    if (solverThread) {
+        solver->cancel();
+        solverThread->wait();
+        delete solverThread;
+        solverThread = nullptr;
+        ++solveRunId; // ignore any of its signals still queued
+        solveButton->setEnabled(true);
+        cancelSolveButton->setEnabled(false);
+        statusBar()->clearMessage();
+    }
+    if (solver) {
+        delete solver;
+        solver = nullptr;
+    }
+}
+
 void MainWindow::solveOptionsRequested()
 {
     AlgorithmDialog dialog(algorithm);
     if (dialog.exec() == QDialog::Accepted) {
         algorithm = dialog.getAlgorithm();
+        PhaseTimer::setEnabled(dialog.countsPhases());
         navigateGroup->setEnabled(false);
     }
 }
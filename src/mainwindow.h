@@ -7,8 +7,10 @@
 
 class AbstractSolver;
 class LevelEditor;
+class SolverThread;
 class QGraphicsView;
 class QGroupBox;
+class QPushButton;
 
 class MainWindow : public QMainWindow
 {
@@ -17,12 +19,17 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
-    enum Algorithm { DFS, BFS, LCFS, AStar };
+    enum Algorithm { DFS, BFS, LCFS, AStar, ParallelAStar, IDAStar, Bidirectional, AnytimeAStar, ExternalAStar };
 private slots:
     void roleChanged(LevelItem::Role role);
     void clearRequested();
     void solveRequested();
+    void cancelSolveRequested();
     void solveOptionsRequested();
+    void solveProgressed(int runId, qint64 nodesExpanded, int frontierSize, double nodesPerSecond, int bestFValue);
+    void solutionImproved(int runId, int cost, int lowerBound);
+    void solveFinished(int runId, bool solved);
+    void solveInterrupted();
     void nextStepRequested();
     void fastForwardRequested();
     void prevStepRequested();
@@ -30,11 +37,15 @@ private slots:
 private:
     void createActions();
     void createGroupBoxes();
+    void stopSolving(); // cancels and waits for any running solve, then deletes the solver
 
     LevelEditor *editorScene;
     QGraphicsView *view;
     AbstractSolver *solver;
+    SolverThread *solverThread;
+    int solveRunId;
     Algorithm algorithm;
+    QString bestSolution; // described for the status bar, empty until an anytime solver publishes one
 
     QGroupBox *tileEditGroup;
     QAction *playerItemAction;
@@ -47,7 +58,10 @@ private:
 
     QGroupBox *solveGroup;
     QAction *solveAction;
+    QAction *cancelSolveAction;
     QAction *solveOptionsAction;
+    QPushButton *solveButton;
+    QPushButton *cancelSolveButton;
 
     QGroupBox *navigateGroup;
     QAction *nextStepAction;
@@ -0,0 +1,63 @@
+#include "legacyreach.h"
+#include "levelprobe.h"
+
+#include <QList>
+#include <QPair>
+#include <QQueue>
+
+inline uint qHash(const QPoint &key)
+{
+    return qHash(QPair<int, int>(key.x(), key.y()));
+}
+
+LegacyReach::LegacyReach(const LevelFormat *format) :
+    level(format)
+{
+    LevelState empty = *format->getInitialState();
+    empty.movables = Bitboard();
+    PlayerReach reach;
+    LevelProbe::getPlayerReach(format, &empty, &reach);
+    const Bitboard &cells = reach.cells();
+    for (int cell = cells.first(); cell != -1; cell = cells.next(cell))
+        floor.insert(format->pointAt(cell));
+}
+
+/*
+ * Unchanged from the original, except that it returns the hash by value
+ * instead of a heap-allocated one for the caller to delete.
+ */
+QHash<QPoint, int> LegacyReach::reachablePointsWithCosts(LevelState *state) const
+{
+    QSet<QPoint> movables;
+    for (int cell = state->movables.first(); cell != -1; cell = state->movables.next(cell))
+        movables.insert(level->pointAt(cell));
+    QHash<QPoint, int> hash;
+    QQueue<QPoint> pointsQueue;
+    QQueue<int> costsQueue;
+    pointsQueue.enqueue(level->pointAt(state->player));
+    costsQueue.enqueue(0);
+    while (!pointsQueue.isEmpty()) {
+        QPoint point = pointsQueue.dequeue();
+        int cost = costsQueue.dequeue();
+        if (!hash.contains(point)) {
+            hash.insert(point, cost);
+            QList<QPoint> nextPoints;
+            nextPoints << QPoint(point.x() - 1, point.y());
+            nextPoints << QPoint(point.x() + 1, point.y());
+            nextPoints << QPoint(point.x(), point.y() - 1);
+            nextPoints << QPoint(point.x(), point.y() + 1);
+            for (QPoint nextPoint : nextPoints) {
+                if (isValid(movables, nextPoint)) {
+                    pointsQueue.enqueue(nextPoint);
+                    costsQueue.enqueue(cost + 1);
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+bool LegacyReach::isValid(const QSet<QPoint> &movables, const QPoint &point) const
+{
+    return floor.contains(point) && !movables.contains(point);
+}
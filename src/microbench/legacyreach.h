@@ -0,0 +1,32 @@
+#ifndef LEGACYREACH_H
+#define LEGACYREACH_H
+
+#include "levelformat.h"
+
+#include <QHash>
+#include <QPoint>
+#include <QSet>
+
+/*
+ * The player reachability of the solver before levels were stored as
+ * bitboards: a breadth-first search over QPoints, with the walls and boxes
+ * in QSets, returning the walking distance to every reachable cell. Kept
+ * as a reference to measure LevelFormat::getPlayerReach against.
+ */
+
+class LegacyReach
+{
+public:
+    LegacyReach(const LevelFormat *format);
+
+    QHash<QPoint, int> reachablePointsWithCosts(LevelState *state) const;
+private:
+    bool isValid(const QSet<QPoint> &movables, const QPoint &point) const;
+
+    const LevelFormat *level;
+    // cells the player could reach if there were no boxes, anything else
+    // counts as a wall
+    QSet<QPoint> floor;
+};
+
+#endif // LEGACYREACH_H
@@ -0,0 +1,24 @@
+#ifndef LEVELPROBE_H
+#define LEVELPROBE_H
+
+#include "levelformat.h"
+
+/*
+ * Calls the LevelFormat primitives that are private to it, so that they
+ * can be timed on their own.
+ */
+
+class LevelProbe
+{
+public:
+    static void getPlayerReach(const LevelFormat *format, LevelState *state, PlayerReach *reach)
+    {
+        format->getPlayerReach(state, reach);
+    }
+    static bool blockExists(const LevelFormat *format, LevelState *state)
+    {
+        return format->blockExists(state);
+    }
+};
+
+#endif // LEVELPROBE_H
@@ -0,0 +1,358 @@
+#include "legacyreach.h"
+#include "levelprobe.h"
+#include "levelcollection.h"
+#include "statecapture.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+namespace {
+
+// heap allocations made so far by any thread, counted by the allocation
+// functions below
+std::atomic<qint64> allocations(0);
+
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Level
+{
+    LevelFormat *format;
+    QVector<LevelState> states; // sampled from a search
+    QVector<QVector<LevelState>> children; // the next states of each one
+    QVector<LevelState> walkedStates; // each state with the player moved as far as it can walk
+};
+
+/*
+ * A benchmark runs over every sampled state of every level in one pass,
+ * and returns how many calls that pass made. What it times is up to it,
+ * so setup work can be left out: it adds the nanoseconds timed to the
+ * counter it is given.
+ */
+struct Benchmark
+{
+    QString name;
+    std::function<qint64(qint64 *nanoseconds)> pass;
+};
+
+struct Measurement
+{
+    qint64 callsPerPass;
+    double medianNanoseconds; // per call, over the rounds
+    double fastestNanoseconds;
+    double spread; // median absolute deviation over the median
+    double allocationsPerCall;
+};
+
+// times a whole loop over the states, for primitives too cheap to time per call
+qint64 timeLoop(qint64 *nanoseconds, const std::function<qint64()> &loop)
+{
+    qint64 start = now();
+    qint64 calls = loop();
+    *nanoseconds += now() - start;
+    return calls;
+}
+
+double median(QVector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    int middle = values.size() / 2;
+    return values.size() % 2 ? values.at(middle) : (values.at(middle - 1) + values.at(middle)) / 2;
+}
+
+/*
+ * One warm-up pass (which also fills the level's learned deadlocks and the
+ * matching caches, as a search would have), one pass counting allocations,
+ * then rounds of as many passes as fit in the minimum round time. The
+ * median over the rounds is what is reported, with the median absolute
+ * deviation as a measure of how far it can be trusted.
+ */
+Measurement measure(const Benchmark &benchmark, int rounds, qint64 minimumRoundNanoseconds)
+{
+    Measurement measurement;
+    qint64 ignored = 0;
+    benchmark.pass(&ignored);
+    qint64 allocationsBefore = allocations.load();
+    measurement.callsPerPass = benchmark.pass(&ignored);
+    measurement.allocationsPerCall = measurement.callsPerPass
+            ? double(allocations.load() - allocationsBefore) / measurement.callsPerPass : 0;
+
+    QVector<double> perCall;
+    qint64 roundStart = now();
+    for (int round = 0; round < rounds && measurement.callsPerPass > 0; ++round) {
+        qint64 calls = 0;
+        qint64 nanoseconds = 0;
+        do {
+            calls += benchmark.pass(&nanoseconds);
+        } while (now() - roundStart < minimumRoundNanoseconds);
+        perCall.append(double(nanoseconds) / calls);
+        roundStart = now();
+    }
+    if (perCall.isEmpty()) {
+        measurement.medianNanoseconds = 0;
+        measurement.fastestNanoseconds = 0;
+        measurement.spread = 0;
+        return measurement;
+    }
+    measurement.medianNanoseconds = median(perCall);
+    measurement.fastestNanoseconds = *std::min_element(perCall.begin(), perCall.end());
+    QVector<double> deviations;
+    for (double value : perCall)
+        deviations.append(qAbs(value - measurement.medianNanoseconds));
+    measurement.spread = measurement.medianNanoseconds > 0 ? median(deviations) / measurement.medianNanoseconds : 0;
+    return measurement;
+}
+
+QVector<Benchmark> benchmarksFor(QVector<Level> &levels, bool legacy)
+{
+    QVector<Benchmark> benchmarks;
+    QVector<LevelState> nextStates;
+    benchmarks.append({ "nextStatesFor", [&levels, nextStates](qint64 *nanoseconds) mutable {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            for (Level &level : levels) {
+                for (LevelState &state : level.states) {
+                    level.format->nextStatesFor(&state, nextStates);
+                    ++calls;
+                }
+            }
+            return calls;
+        });
+    } });
+    // the heuristic is updated from the parent's, which nextStatesFor
+    // sets up, so each state's children are timed after generating them
+    benchmarks.append({ "getHeuristic", [&levels, nextStates](qint64 *nanoseconds) mutable {
+        qint64 calls = 0;
+        for (Level &level : levels) {
+            for (LevelState &state : level.states) {
+                level.format->nextStatesFor(&state, nextStates);
+                qint64 start = now();
+                for (LevelState &nextState : nextStates)
+                    level.format->getHeuristic(&nextState);
+                *nanoseconds += now() - start;
+                calls += nextStates.size();
+            }
+        }
+        return calls;
+    } });
+    benchmarks.append({ "blockExists", [&levels](qint64 *nanoseconds) {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            for (Level &level : levels) {
+                for (QVector<LevelState> &children : level.children) {
+                    for (LevelState &child : children)
+                        LevelProbe::blockExists(level.format, &child);
+                    calls += children.size();
+                }
+            }
+            return calls;
+        });
+    } });
+    benchmarks.append({ "goalReached", [&levels](qint64 *nanoseconds) {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            int reached = 0;
+            for (Level &level : levels) {
+                for (QVector<LevelState> &children : level.children) {
+                    for (LevelState &child : children)
+                        reached += level.format->goalReached(&child) ? 1 : 0;
+                    calls += children.size();
+                }
+            }
+            // keeps the calls from being optimized out
+            return calls + (reached < 0 ? 1 : 0);
+        });
+    } });
+    benchmarks.append({ "getPlayerReach", [&levels](qint64 *nanoseconds) {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            PlayerReach reach;
+            for (Level &level : levels) {
+                for (LevelState &state : level.states) {
+                    LevelProbe::getPlayerReach(level.format, &state, &reach);
+                    ++calls;
+                }
+            }
+            return calls;
+        });
+    } });
+    benchmarks.append({ "similarTo", [&levels](qint64 *nanoseconds) {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            int similar = 0;
+            for (Level &level : levels) {
+                for (int i = 0; i < level.states.size(); ++i) {
+                    similar += level.format->similarTo(&level.states[i], &level.walkedStates[i]) ? 1 : 0;
+                    ++calls;
+                }
+            }
+            return calls + (similar < 0 ? 1 : 0);
+        });
+    } });
+    if (!legacy)
+        return benchmarks;
+    QVector<LegacyReach> references;
+    for (const Level &level : levels)
+        references.append(LegacyReach(level.format));
+    benchmarks.append({ "QSet<QPoint> reach", [&levels, references](qint64 *nanoseconds) {
+        return timeLoop(nanoseconds, [&]() {
+            qint64 calls = 0;
+            for (int i = 0; i < levels.size(); ++i) {
+                for (LevelState &state : levels[i].states) {
+                    references.at(i).reachablePointsWithCosts(&state);
+                    ++calls;
+                }
+            }
+            return calls;
+        });
+    } });
+    return benchmarks;
+}
+
+}
+
+#ifdef __GLIBC__
+// every allocation goes through malloc, Qt's containers included
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+#else
+// elsewhere only what goes through new is counted, which leaves out Qt's
+// containers, as they call malloc directly
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+/*
+ * Runs A* on each level of the corpus, samples the states it generated,
+ * and times each primitive over them.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sokoban-microbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the LevelFormat primitives on states captured from real searches.");
+    parser.addHelpOption();
+    QCommandLineOption statesOption(QStringList() << "s" << "states",
+                                    "States sampled from the search of each level (default 200).",
+                                    "count", "200");
+    parser.addOption(statesOption);
+    QCommandLineOption roundsOption(QStringList() << "r" << "rounds",
+                                    "Timed rounds per primitive, the median of which is reported (default 9).",
+                                    "count", "9");
+    parser.addOption(roundsOption);
+    QCommandLineOption roundTimeOption(QStringList() << "round-time",
+                                       "Minimum length of a round in milliseconds (default 100).",
+                                       "ms", "100");
+    parser.addOption(roundTimeOption);
+    QCommandLineOption timeLimitOption(QStringList() << "t" << "time-limit",
+                                       "Stop capturing states from a level's search after this many seconds (default 10).",
+                                       "seconds", "10");
+    parser.addOption(timeLimitOption);
+    QCommandLineOption legacyOption(QStringList() << "legacy",
+                                    "Also time the QSet<QPoint> reachability the solver used before bitboards.");
+    parser.addOption(legacyOption);
+    parser.addPositionalArgument("corpus", "Levels to capture states from (default: the benchmark corpus).");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QString corpus = parser.positionalArguments().value(0, BENCH_CORPUS);
+    LevelCollection collection;
+    if (!collection.open(corpus)) {
+        err << "Cannot open " << corpus << ": " << collection.errorString() << "\n";
+        return 2;
+    }
+    int sampleSize = qMax(1, parser.value(statesOption).toInt());
+    qint64 timeLimit = qint64(parser.value(timeLimitOption).toDouble() * 1000);
+    QVector<Level> levels;
+    int capturedStates = 0;
+    while (collection.hasNext()) {
+        LevelFormat *format = collection.next();
+        if (!format)
+            continue;
+        StateCapture capture(format);
+        capture.setTimeLimit(timeLimit);
+        capture.run();
+        Level level;
+        level.format = format;
+        level.states = capture.sample(sampleSize);
+        QVector<LevelState> nextStates;
+        for (LevelState &state : level.states) {
+            format->nextStatesFor(&state, nextStates);
+            level.children.append(nextStates);
+            PlayerReach reach;
+            LevelProbe::getPlayerReach(format, &state, &reach);
+            LevelState walked = state;
+            const Bitboard &cells = reach.cells();
+            for (int cell = cells.first(); cell != -1; cell = cells.next(cell)) {
+                if (reach.distanceTo(cell) > reach.distanceTo(walked.player))
+                    walked.player = cell;
+            }
+            level.walkedStates.append(walked);
+        }
+        capturedStates += level.states.size();
+        levels.append(level);
+    }
+    out << "Captured " << capturedStates << " states from " << levels.size() << " levels\n";
+    out << QString("%1 %2 %3 %4 %5 %6\n").arg("primitive", -20).arg("calls", 10).arg("median ns", 12)
+           .arg("fastest ns", 12).arg("spread", 8).arg("allocs/call", 12);
+    out.flush();
+
+    int rounds = qMax(1, parser.value(roundsOption).toInt());
+    qint64 roundTime = qint64(parser.value(roundTimeOption).toDouble() * 1000000);
+    for (const Benchmark &benchmark : benchmarksFor(levels, parser.isSet(legacyOption))) {
+        Measurement measurement = measure(benchmark, rounds, roundTime);
+        out << QString("%1 %2 %3 %4 %5 %6\n").arg(benchmark.name, -20).arg(measurement.callsPerPass, 10)
+               .arg(measurement.medianNanoseconds, 12, 'f', 1).arg(measurement.fastestNanoseconds, 12, 'f', 1)
+               .arg(QString("%1%").arg(measurement.spread * 100, 0, 'f', 1), 8)
+               .arg(measurement.allocationsPerCall, 12, 'f', 2);
+        out.flush();
+    }
+
+    for (Level &level : levels)
+        delete level.format;
+    return 0;
+}
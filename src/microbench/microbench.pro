@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Microbenchmark: times the LevelFormat
+# primitives the solvers spend their time in,
+# on states captured from real searches of the
+# levels in ../bench/corpus.xsb.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = sokoban-microbench
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += BENCH_CORPUS=\\\"$$PWD/../bench/corpus.xsb\\\"
+
+include(../core.pri)
+
+SOURCES += \
+        main.cpp \
+    statecapture.cpp \
+    legacyreach.cpp
+
+HEADERS += \
+    levelprobe.h \
+    statecapture.h \
+    legacyreach.h
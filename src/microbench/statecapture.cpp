@@ -0,0 +1,22 @@
+#include "statecapture.h"
+
+StateCapture::StateCapture(LevelFormat *format) :
+    AStarSolver (format)
+{
+
+}
+
+QVector<LevelState> StateCapture::sample(int count) const
+{
+    QVector<LevelState> states;
+    int generated = nodes.size();
+    if (generated == 0 || count <= 0)
+        return states;
+    count = qMin(count, generated);
+    for (int i = 0; i < count; ++i) {
+        LevelState state = *nodes.at(quint32(qint64(i) * generated / count));
+        state.previousState = NodeArena::NoNode;
+        states.append(state);
+    }
+    return states;
+}
@@ -0,0 +1,24 @@
+#ifndef STATECAPTURE_H
+#define STATECAPTURE_H
+
+#include "astarsolver.h"
+
+#include <QVector>
+
+/*
+ * A* that keeps its node arena after the search, so that states it
+ * generated can be sampled to run benchmarks on states as they occur in
+ * real searches rather than made up ones.
+ */
+
+class StateCapture : public AStarSolver
+{
+public:
+    StateCapture(LevelFormat *format);
+
+    // up to count states spread evenly over the order they were generated
+    // in, so early, shallow states and late, deep ones are all represented
+    QVector<LevelState> sample(int count) const;
+};
+
+#endif // STATECAPTURE_H
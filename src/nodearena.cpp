@@ -0,0 +1,41 @@
+#include "nodearena.h"
+#include "phasecounters.h"
+
+#include <new>
+
+NodeArena::NodeArena() :
+    count(0)
+{
+
+}
+
+NodeArena::~NodeArena()
+{
+    // states are trivially destructible, so only the storage needs freeing
+    for (LevelState *slab : slabs)
+        ::operator delete(slab);
+}
+
+/*
+ * Copies a state into the arena, linking it to its parent, and returns
+ * its index.
+ */
+quint32 NodeArena::allocate(const LevelState &state, quint32 parent)
+{
+    PhaseTimer timer(PhaseTotals::Allocation);
+    if ((count & (SlabSize - 1)) == 0 && int(count >> SlabShift) == slabs.size())
+        slabs.append(static_cast<LevelState *>(::operator new(sizeof(LevelState) * SlabSize)));
+    LevelState *node = new (slabs.at(count >> SlabShift) + (count & (SlabSize - 1))) LevelState(state);
+    node->previousState = parent;
+    return count++;
+}
+
+int NodeArena::size() const
+{
+    return int(count);
+}
+
+qint64 NodeArena::bytesAllocated() const
+{
+    return qint64(slabs.size()) * SlabSize * qint64(sizeof(LevelState));
+}
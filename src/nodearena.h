@@ -0,0 +1,42 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include "levelformat.h"
+
+#include <QVector>
+
+/*
+ * Owns every state created during a solve. States are copied into large
+ * slabs that are never moved, so pointers returned by at() stay valid, and
+ * refer to their parent by 32-bit index (NoNode for the initial state). All
+ * slabs are released at once when the arena is destroyed.
+ */
+
+class NodeArena
+{
+public:
+    enum : quint32 { NoNode = 0xffffffffu };
+
+    NodeArena();
+    ~NodeArena();
+
+    quint32 allocate(const LevelState &state, quint32 parent);
+    LevelState *at(quint32 index) const;
+    int size() const;
+    qint64 bytesAllocated() const;
+private:
+    Q_DISABLE_COPY(NodeArena)
+
+    static const int SlabShift = 14;
+    static const int SlabSize = 1 << SlabShift;
+
+    QVector<LevelState *> slabs;
+    quint32 count;
+};
+
+inline LevelState *NodeArena::at(quint32 index) const
+{
+    return slabs.at(index >> SlabShift) + (index & (SlabSize - 1));
+}
+
+#endif // NODEARENA_H
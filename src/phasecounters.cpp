@@ -0,0 +1,90 @@
+#include "phasecounters.h"
+
+#include <chrono>
+
+namespace {
+
+thread_local PhaseTotals totals;
+thread_local PhaseTimer *innermost = nullptr;
+
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+const char *PhaseTotals::name(int phase)
+{
+    static const char *const names[PhaseCount] = {
+        "nextStatesFor", "getHeuristic", "blockExists", "duplicate check", "allocation"
+    };
+    return names[phase];
+}
+
+bool PhaseTotals::any() const
+{
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        if (calls[phase] != 0)
+            return true;
+    }
+    return false;
+}
+
+PhaseTotals PhaseTotals::operator-(const PhaseTotals &other) const
+{
+    PhaseTotals difference = *this;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        difference.calls[phase] -= other.calls[phase];
+        difference.nanoseconds[phase] -= other.nanoseconds[phase];
+    }
+    return difference;
+}
+
+PhaseTotals &PhaseTotals::operator+=(const PhaseTotals &other)
+{
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        calls[phase] += other.calls[phase];
+        nanoseconds[phase] += other.nanoseconds[phase];
+    }
+    return *this;
+}
+
+QAtomicInt PhaseTimer::enabled(0);
+
+void PhaseTimer::setEnabled(bool enabled)
+{
+    PhaseTimer::enabled.storeRelease(enabled ? 1 : 0);
+}
+
+bool PhaseTimer::isEnabled()
+{
+#ifdef NO_PHASE_COUNTERS
+    return false;
+#else
+    return enabled.loadAcquire() != 0;
+#endif
+}
+
+PhaseTotals PhaseTimer::threadTotals()
+{
+    return totals;
+}
+
+void PhaseTimer::begin()
+{
+    outer = innermost;
+    innermost = this;
+    start = now();
+}
+
+void PhaseTimer::end()
+{
+    qint64 elapsed = now() - start;
+    ++totals.calls[phase];
+    totals.nanoseconds[phase] += elapsed - nested;
+    innermost = outer;
+    if (outer)
+        outer->nested += elapsed;
+}
@@ -0,0 +1,85 @@
+#ifndef PHASECOUNTERS_H
+#define PHASECOUNTERS_H
+
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/*
+ * Call counts and time spent in each phase of expanding a node. Times are
+ * self times: a phase called from another (blockExists from getHeuristic,
+ * say) is taken out of its caller's time, so the phases add up to at most
+ * the time of the solve.
+ */
+struct PhaseTotals
+{
+    enum Phase {
+        NextStates, // LevelFormat::nextStatesFor
+        Heuristic, // LevelFormat::getHeuristic
+        Deadlock, // LevelFormat::blockExists
+        Duplicates, // TranspositionTable lookups
+        Allocation, // NodeArena::allocate
+        PhaseCount
+    };
+
+    qint64 calls[PhaseCount];
+    qint64 nanoseconds[PhaseCount];
+
+    static const char *name(int phase);
+    bool any() const;
+    PhaseTotals operator-(const PhaseTotals &other) const;
+    PhaseTotals &operator+=(const PhaseTotals &other);
+};
+
+/*
+ * Times the scope it is declared in as the given phase, if timing is
+ * enabled. Each thread adds to totals of its own, so counting needs no
+ * locking, and a solver finds its share by taking the difference of the
+ * totals before and after its solve. Timing is off by default, as reading
+ * the clock costs about as much as a cheap phase; building with
+ * CONFIG += no_phase_counters removes the timers altogether.
+ */
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(PhaseTotals::Phase phase);
+    ~PhaseTimer();
+
+    // takes effect for the timers created afterwards, set it before solving
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    static PhaseTotals threadTotals(); // of the calling thread
+private:
+    Q_DISABLE_COPY(PhaseTimer)
+
+    void begin();
+    void end();
+
+    PhaseTotals::Phase phase;
+    qint64 start; // -1 if not timing
+    qint64 nested; // time of the timers started inside this one
+    PhaseTimer *outer;
+
+    static QAtomicInt enabled;
+};
+
+inline PhaseTimer::PhaseTimer(PhaseTotals::Phase phase) :
+    phase(phase),
+    start(-1),
+    nested(0),
+    outer(nullptr)
+{
+#ifndef NO_PHASE_COUNTERS
+    if (enabled.loadAcquire())
+        begin();
+#endif
+}
+
+inline PhaseTimer::~PhaseTimer()
+{
+#ifndef NO_PHASE_COUNTERS
+    if (start != -1)
+        end();
+#endif
+}
+
+#endif // PHASECOUNTERS_H
@@ -0,0 +1,23 @@
+#include "solverthread.h"
+#include "abstractsolver.h"
+
+SolverThread::SolverThread(AbstractSolver *solver, int runId, QObject *parent) :
+    QThread(parent),
+    solver(solver),
+    id(runId)
+{
+
+}
+
+void SolverThread::run()
+{
+    solver->setProgressCallback([this](const SolveProgress &progress) {
+        emit progressed(id, progress.nodesExpanded, progress.frontierSize,
+                        progress.nodesPerSecond, progress.bestFValue);
+    });
+    solver->setSolutionCallback([this](const SolutionReport &report) {
+        emit solutionImproved(id, report.cost, report.lowerBound);
+    });
+    bool solved = solver->run();
+    emit solveFinished(id, solved);
+}
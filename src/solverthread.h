@@ -0,0 +1,32 @@
+#ifndef SOLVERTHREAD_H
+#define SOLVERTHREAD_H
+
+#include <QThread>
+
+class AbstractSolver;
+
+/*
+ * Runs a solver off the GUI thread. Progress and completion are forwarded
+ * through signals, which reach the GUI as queued calls; the run id lets the
+ * receiver ignore signals from a solve it has already abandoned. The thread
+ * does not own the solver.
+ */
+
+class SolverThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    SolverThread(AbstractSolver *solver, int runId, QObject *parent = nullptr);
+signals:
+    void progressed(int runId, qint64 nodesExpanded, int frontierSize, double nodesPerSecond, int bestFValue);
+    void solutionImproved(int runId, int cost, int lowerBound);
+    void solveFinished(int runId, bool solved);
+protected:
+    void run() override;
+private:
+    AbstractSolver *solver;
+    int id;
+};
+
+#endif // SOLVERTHREAD_H
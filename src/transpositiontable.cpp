@@ -0,0 +1,63 @@
+#include "transpositiontable.h"
+#include "phasecounters.h"
+
+TranspositionTable::TranspositionTable(const LevelFormat *format) :
+    level(format),
+    entries(0)
+{
+
+}
+
+bool TranspositionTable::insert(LevelState *state)
+{
+    PhaseTimer timer(PhaseTotals::Duplicates);
+    StateKey key = level->keyFor(state);
+    if (buckets.contains(key))
+        return false;
+    buckets[key].append(state);
+    ++entries;
+    return true;
+}
+
+/*
+ * Equivalent to the old pairwise similarTo(a, b, tolerance) scan, except
+ * that only states sharing a canonical key are compared, since those are
+ * the only ones that can be within reach of each other.
+ */
+bool TranspositionTable::insertIfCheaper(LevelState *state)
+{
+    PhaseTimer timer(PhaseTotals::Duplicates);
+    QList<LevelState *> &bucket = buckets[level->keyFor(state)];
+    for (int i = 0; i < bucket.size(); ++i) {
+        LevelState *seenState = bucket.at(i);
+        int distance = level->distanceForPlayerToMoveTo(state, seenState->player);
+        if (seenState->cost + distance <= state->cost) {
+            return false;
+        } else if (state->cost + distance <= seenState->cost) {
+            bucket.removeAt(i--);
+            --entries;
+        }
+    }
+    bucket.append(state);
+    ++entries;
+    return true;
+}
+
+int TranspositionTable::size() const
+{
+    return entries;
+}
+
+/*
+ * Every key has a hash node (next pointer, hash, key and list) and a list
+ * block (a header and a pointer per state), and the hash keeps a pointer
+ * per bucket on top of that.
+ */
+qint64 TranspositionTable::bytesUsed() const
+{
+    const qint64 nodeBytes = sizeof(void *) + sizeof(uint) + sizeof(StateKey) + sizeof(QList<LevelState *>);
+    const qint64 listHeaderBytes = 4 * sizeof(int);
+    return qint64(buckets.capacity()) * qint64(sizeof(void *))
+            + qint64(buckets.size()) * (nodeBytes + listHeaderBytes)
+            + qint64(entries) * qint64(sizeof(LevelState *));
+}
@@ -0,0 +1,37 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include "levelformat.h"
+
+#include <QHash>
+#include <QList>
+
+/*
+ * Closed set shared by the solvers. States are bucketed by their canonical
+ * key, so finding the states a new one could duplicate is a single hash
+ * lookup instead of a scan over everything seen so far. The table does not
+ * own the states inserted into it.
+ */
+
+class TranspositionTable
+{
+public:
+    TranspositionTable(const LevelFormat *format);
+
+    // for non-cost-based solvers, returns false if an equivalent state
+    // has already been inserted
+    bool insert(LevelState *state);
+    // for cost-based solvers, returns false if an inserted state with the
+    // same boxes can reach this one's player position within the cost
+    // difference, otherwise inserts it and drops the entries it dominates
+    bool insertIfCheaper(LevelState *state);
+
+    int size() const;
+    qint64 bytesUsed() const; // an estimate that leaves out the allocator's overhead
+private:
+    const LevelFormat *level;
+    QHash<StateKey, QList<LevelState *>> buckets;
+    int entries;
+};
+
+#endif // TRANSPOSITIONTABLE_H